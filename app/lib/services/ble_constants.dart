@@ -11,6 +11,14 @@ const String waterNowCharUuid = 'DEAD0004-C634-45D2-A209-C636967B81B2';
 const String statusCharUuid = 'DEAD0005-C634-45D2-A209-C636967B81B2';
 const String lastWateredCharUuid = 'DEAD0006-C634-45D2-A209-C636967B81B2';
 const String nextWateringCharUuid = 'DEAD0007-C634-45D2-A209-C636967B81B2';
+const String statsCharUuid = 'DEAD0008-C634-45D2-A209-C636967B81B2';
+const String pumpFaultCharUuid = 'DEAD0009-C634-45D2-A209-C636967B81B2';
+const String scheduleCharUuid = 'DEAD000A-C634-45D2-A209-C636967B81B2';
+
+// Fleet gateway service and characteristics
+const String fleetServiceUuid = 'DEAD0200-C634-45D2-A209-C636967B81B2';
+const String fleetUnitsCharUuid = 'DEAD0201-C634-45D2-A209-C636967B81B2';
+const String fleetCommandCharUuid = 'DEAD0202-C634-45D2-A209-C636967B81B2';
 
 // Device name prefix for scanning
 const String DEVICE_NAME_PREFIX = 'Watering Service';
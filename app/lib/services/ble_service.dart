@@ -39,6 +39,9 @@ class BleService extends ChangeNotifier {
   bool _isWatering = false;
   int _lastWateredSeconds = 0;
   String? _connectedDeviceId;
+  int _controlWrites = 0;
+  int _controlWriteTotalMs = 0;
+  int _controlWriteMaxMs = 0;
 
   BleService() {
     _checkExistingConnection();
@@ -360,12 +363,27 @@ class BleService extends ChangeNotifier {
     _nextWateringChar = null;
   }
 
+  // Times each control write from request to write response; the firmware,
+  // as GATT server, cannot see when its response arrives
+  Future<void> _writeControl(
+      QualifiedCharacteristic characteristic, List<int> value) async {
+    final stopwatch = Stopwatch()..start();
+    await _ble.writeCharacteristicWithResponse(characteristic, value: value);
+    stopwatch.stop();
+
+    final ms = stopwatch.elapsedMilliseconds;
+    _controlWrites++;
+    _controlWriteTotalMs += ms;
+    if (ms > _controlWriteMaxMs) {
+      _controlWriteMaxMs = ms;
+    }
+    print('Control write: $ms ms '
+        '(avg ${_controlWriteTotalMs ~/ _controlWrites} ms, max $_controlWriteMaxMs ms)');
+  }
+
   Future<void> setMode(PlantMode mode) async {
     if (_modeChar != null) {
-      await _ble.writeCharacteristicWithResponse(
-        _modeChar!,
-        value: [mode.index],
-      );
+      await _writeControl(_modeChar!, [mode.index]);
       setState(() {
         _state = _state.copyWith(mode: mode);
       });
@@ -376,10 +394,7 @@ class BleService extends ChangeNotifier {
     if (_intervalChar != null) {
       // Convert to little-endian
       final value = [minutes & 0xFF, minutes >> 8];
-      await _ble.writeCharacteristicWithResponse(
-        _intervalChar!,
-        value: value,
-      );
+      await _writeControl(_intervalChar!, value);
       setState(() {
         _state = _state.copyWith(intervalMinutes: minutes);
       });
@@ -390,10 +405,7 @@ class BleService extends ChangeNotifier {
     if (_amountChar != null) {
       // Convert to little-endian
       final value = [ml & 0xFF, ml >> 8];
-      await _ble.writeCharacteristicWithResponse(
-        _amountChar!,
-        value: value,
-      );
+      await _writeControl(_amountChar!, value);
       setState(() {
         _state = _state.copyWith(amountMl: ml);
       });
@@ -402,10 +414,7 @@ class BleService extends ChangeNotifier {
 
   Future<void> triggerWatering() async {
     if (_waterNowChar != null) {
-      await _ble.writeCharacteristicWithResponse(
-        _waterNowChar!,
-        value: [1],
-      );
+      await _writeControl(_waterNowChar!, [1]);
       setState(() {
         _isWatering = true;
         _state = _state.copyWith(isWatering: true);
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+# Run a fleet gateway and N member units together in BabbleSim.
+#
+# Build both images for nrf52_bsim first (see README, "Fleet mode"), then:
+#   scripts/fleet_bsim.sh <gateway zephyr.exe> <member zephyr.exe> [members] [seconds]
+#
+# Needs BSIM_OUT_PATH pointing at a BabbleSim build.
+set -euo pipefail
+
+GATEWAY_EXE=${1:?gateway zephyr.exe}
+MEMBER_EXE=${2:?member zephyr.exe}
+MEMBERS=${3:-4}
+SECONDS_TO_RUN=${4:-120}
+SIM_ID=watering_fleet
+
+: "${BSIM_OUT_PATH:?Set BSIM_OUT_PATH to the BabbleSim output directory}"
+
+pids=()
+cleanup() { kill "${pids[@]}" 2>/dev/null || true; }
+trap cleanup EXIT
+
+"${GATEWAY_EXE}" -s="${SIM_ID}" -d=0 -rs=1 > gateway.log 2>&1 &
+pids+=($!)
+
+for i in $(seq 1 "${MEMBERS}"); do
+    # Different random seeds give every member its own address
+    "${MEMBER_EXE}" -s="${SIM_ID}" -d="${i}" -rs=$((i + 1)) > "member_${i}.log" 2>&1 &
+    pids+=($!)
+done
+
+cd "${BSIM_OUT_PATH}/bin"
+./bs_2G4_phy_v1 -s="${SIM_ID}" -D=$((MEMBERS + 1)) -sim_length=$((SECONDS_TO_RUN * 1000000))
+
+seen=$(grep -c "Fleet unit .* joined" "${OLDPWD}/gateway.log" || true)
+echo "Gateway saw ${seen} of ${MEMBERS} units"
+[ "${seen}" -ge "${MEMBERS}" ]
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""Convert the output of the 'gatt_trace dump' shell command to a binary trace.
+
+Usage: gatt_trace_to_bin.py <console log> <trace.bin>
+"""
+import re
+import sys
+
+HEADER_LINE = re.compile(r"GATT trace: (\d+) bytes")
+HEXDUMP_LINE = re.compile(r"^\s*([0-9a-fA-F]{8}):(.*)$")
+BYTES_PER_LINE = 16
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    total = None
+    data = bytearray()
+    with open(sys.argv[1], encoding="utf-8", errors="replace") as log:
+        for line in log:
+            header = HEADER_LINE.search(line)
+            if header:
+                total = int(header.group(1))
+                data.clear()
+                continue
+
+            match = HEXDUMP_LINE.match(line)
+            if total is None or not match:
+                continue
+            if int(match.group(1), 16) != len(data):
+                sys.exit(f"Unexpected offset in line: {line.strip()}")
+
+            # The ASCII column follows the hex bytes; the total length trims it
+            tokens = match.group(2).split()[:BYTES_PER_LINE]
+            data += bytes(int(t, 16) for t in tokens if re.fullmatch(r"[0-9a-fA-F]{2}", t))
+
+    if total is None:
+        sys.exit("No GATT trace found")
+
+    data = data[:total]
+    if not data.startswith(b"GTR2"):
+        sys.exit("GATT trace has no valid header")
+
+    with open(sys.argv[2], "wb") as out:
+        out.write(data)
+    print(f"Wrote {len(data)} bytes to {sys.argv[2]}")
+
+
+if __name__ == "__main__":
+    main()
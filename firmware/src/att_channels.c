@@ -0,0 +1,120 @@
+#include "att_channels.h"
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/att.h>
+
+LOG_MODULE_REGISTER(att_channels, LOG_LEVEL_INF);
+
+/* A bulk transfer counts as running until this long after its last read */
+#define BULK_HOLD_MS 250
+
+/* Notifications up to this size are control traffic, larger ones are bulk */
+#define CONTROL_MAX_LEN 20
+
+/**
+ * @brief Control notification delivery samples
+ */
+struct latency_stats
+{
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+};
+
+static struct latency_stats idle_latency;
+static struct latency_stats bulk_latency;
+static atomic_t bulk_until_ms;
+
+static bool bulk_active(void)
+{
+    return (int32_t)(atomic_get(&bulk_until_ms) - k_uptime_get_32()) > 0;
+}
+
+static void latency_add(struct latency_stats *stats, uint32_t us)
+{
+    stats->count++;
+    stats->total_us += us;
+    stats->max_us = MAX(stats->max_us, us);
+}
+
+static void latency_log(const char *name, const struct latency_stats *stats)
+{
+    uint32_t avg_us = stats->count ? (uint32_t)(stats->total_us / stats->count) : 0;
+    LOG_INF("Control notification delivery %s: %u samples, avg %u us, max %u us", name,
+            stats->count, avg_us, stats->max_us);
+}
+
+// Completion of a control notification; user_data holds the cycle count at send time
+static void notify_sent(struct bt_conn *conn, void *user_data)
+{
+    uint32_t cycles = k_cycle_get_32() - (uint32_t)(uintptr_t)user_data;
+    uint32_t us = k_cyc_to_us_floor32(cycles);
+
+    latency_add(bulk_active() ? &bulk_latency : &idle_latency, us);
+}
+
+void att_channels_mark_bulk(void)
+{
+    atomic_set(&bulk_until_ms, (atomic_val_t)(k_uptime_get_32() + BULK_HOLD_MS));
+}
+
+void att_channels_prepare_notify(struct bt_conn *conn, struct bt_gatt_notify_params *params)
+{
+    bool bulk = params->len > CONTROL_MAX_LEN;
+
+    // The unenhanced bearer is kept for control traffic, bulk goes on the enhanced ones
+    if (bt_eatt_count(conn) > 0)
+    {
+        params->chan_opt = bulk ? BT_ATT_CHAN_OPT_ENHANCED_ONLY : BT_ATT_CHAN_OPT_UNENHANCED_ONLY;
+    }
+
+    if (!bulk)
+    {
+        params->func = notify_sent;
+        params->user_data = (void *)(uintptr_t)k_cycle_get_32();
+    }
+}
+
+/* --- CONNECTION HANDLING --- */
+
+// EATT needs an encrypted link; open the extra bearers once it is. Only on links
+// from a central: a fleet gateway's own links to its neighbours do not need them
+static void att_channels_security_changed(struct bt_conn *conn, bt_security_t level,
+                                          enum bt_security_err err)
+{
+    struct bt_conn_info info;
+
+    if (err || level < BT_SECURITY_L2)
+    {
+        return;
+    }
+
+    if (bt_conn_get_info(conn, &info) || info.role != BT_CONN_ROLE_PERIPHERAL)
+    {
+        return;
+    }
+
+    int rc = bt_eatt_connect(conn, CONFIG_WATERING_EATT_CHANNELS);
+    if (rc && rc != -EALREADY)
+    {
+        LOG_WRN("Failed to open EATT bearers (err %d)", rc);
+        return;
+    }
+
+    LOG_INF("Requested %u EATT bearers", CONFIG_WATERING_EATT_CHANNELS);
+}
+
+static void att_channels_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    latency_log("idle", &idle_latency);
+    latency_log("during bulk", &bulk_latency);
+
+    memset(&idle_latency, 0, sizeof(idle_latency));
+    memset(&bulk_latency, 0, sizeof(bulk_latency));
+}
+
+BT_CONN_CB_DEFINE(att_channels_conn_cb) = {
+    .security_changed = att_channels_security_changed,
+    .disconnected = att_channels_disconnected,
+};
@@ -0,0 +1,43 @@
+#ifndef ATT_CHANNELS_H
+#define ATT_CHANNELS_H
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#if defined(CONFIG_WATERING_EATT)
+
+/**
+ * @brief Mark that a bulk transfer (long read) is in progress
+ *
+ * Call from the read handlers of large characteristics. Control latency
+ * measured while bulk data is flowing is reported separately.
+ */
+void att_channels_mark_bulk(void);
+
+/**
+ * @brief Prepare a notification for sending
+ *
+ * When Enhanced ATT bearers are open, small control notifications are kept
+ * on the unenhanced bearer, which is reserved for control traffic, and
+ * larger bulk notifications go on an enhanced bearer. The delivery time of
+ * control notifications is measured.
+ *
+ * @param conn   Connection the notification is sent on
+ * @param params Notification parameters to update
+ */
+void att_channels_prepare_notify(struct bt_conn *conn, struct bt_gatt_notify_params *params);
+
+#else
+
+static inline void att_channels_mark_bulk(void)
+{
+}
+
+static inline void att_channels_prepare_notify(struct bt_conn *conn,
+                                               struct bt_gatt_notify_params *params)
+{
+}
+
+#endif /* CONFIG_WATERING_EATT */
+
+#endif /* ATT_CHANNELS_H */
@@ -1,10 +1,16 @@
 #include "bluetooth.h"
 #include "plant_common.h"
+#include "watering_stats.h"
+#include "gatt_trace.h"
+#include "att_channels.h"
+#include "fleet.h"
+#include "schedule.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/sys/byteorder.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/hci.h>
@@ -12,34 +18,22 @@
 
 LOG_MODULE_REGISTER(watering_service, LOG_LEVEL_INF);
 
-// Define 128-bit UUIDs for the custom service and its characteristics
-#define BT_UUID_WATERING_SERVICE_VAL BT_UUID_128_ENCODE(0xDEAD0000, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
-#define BT_UUID_WATERING_MODE_VAL BT_UUID_128_ENCODE(0xDEAD0001, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
-#define BT_UUID_WATERING_INTERVAL_VAL BT_UUID_128_ENCODE(0xDEAD0002, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
-#define BT_UUID_WATERING_AMOUNT_VAL BT_UUID_128_ENCODE(0xDEAD0003, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
-#define BT_UUID_WATERING_NOW_VAL BT_UUID_128_ENCODE(0xDEAD0004, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
-#define BT_UUID_WATERING_STATUS_VAL BT_UUID_128_ENCODE(0xDEAD0005, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
-#define BT_UUID_WATERING_LAST_VAL BT_UUID_128_ENCODE(0xDEAD0006, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
-#define BT_UUID_WATERING_NEXT_VAL BT_UUID_128_ENCODE(0xDEAD0007, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
-
-#define BT_UUID_WATERING_SERVICE BT_UUID_DECLARE_128(BT_UUID_WATERING_SERVICE_VAL)
-#define BT_UUID_WATERING_MODE BT_UUID_DECLARE_128(BT_UUID_WATERING_MODE_VAL)
-#define BT_UUID_WATERING_INTERVAL BT_UUID_DECLARE_128(BT_UUID_WATERING_INTERVAL_VAL)
-#define BT_UUID_WATERING_AMOUNT BT_UUID_DECLARE_128(BT_UUID_WATERING_AMOUNT_VAL)
-#define BT_UUID_WATERING_NOW BT_UUID_DECLARE_128(BT_UUID_WATERING_NOW_VAL)
-#define BT_UUID_WATERING_STATUS BT_UUID_DECLARE_128(BT_UUID_WATERING_STATUS_VAL)
-#define BT_UUID_WATERING_LAST BT_UUID_DECLARE_128(BT_UUID_WATERING_LAST_VAL)
-#define BT_UUID_WATERING_NEXT BT_UUID_DECLARE_128(BT_UUID_WATERING_NEXT_VAL)
-
 static struct plant_config *cfg_ptr;
 static struct plant_status *status_ptr;
 static struct bt_conn *current_conn = NULL;
 
+/* Advertising interval in 0.625 ms units (fast connectable by default) */
+static uint16_t adv_interval_min = BT_GAP_ADV_FAST_INT_MIN_2;
+static uint16_t adv_interval_max = BT_GAP_ADV_FAST_INT_MAX_2;
+static bool advertising = false;
+
 /* --- READ CALLBACKS --- */
 
 static ssize_t read_mode(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                          void *buf, uint16_t len, uint16_t offset)
 {
+    gatt_trace_read(attr, offset);
+
     uint8_t mode = (uint8_t)cfg_ptr->mode;
     LOG_INF("Read: Mode = %u", mode);
     return bt_gatt_attr_read(conn, attr, buf, len, offset, &mode, sizeof(mode));
@@ -48,6 +42,8 @@ static ssize_t read_mode(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 static ssize_t read_interval(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                              void *buf, uint16_t len, uint16_t offset)
 {
+    gatt_trace_read(attr, offset);
+
     LOG_INF("Read: Interval = %u", cfg_ptr->interval_min);
     return bt_gatt_attr_read(conn, attr, buf, len, offset, &cfg_ptr->interval_min, sizeof(cfg_ptr->interval_min));
 }
@@ -55,6 +51,8 @@ static ssize_t read_interval(struct bt_conn *conn, const struct bt_gatt_attr *at
 static ssize_t read_amount(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                            void *buf, uint16_t len, uint16_t offset)
 {
+    gatt_trace_read(attr, offset);
+
     LOG_INF("Read: Amount = %u", cfg_ptr->amount_ml);
     return bt_gatt_attr_read(conn, attr, buf, len, offset, &cfg_ptr->amount_ml, sizeof(cfg_ptr->amount_ml));
 }
@@ -62,6 +60,8 @@ static ssize_t read_amount(struct bt_conn *conn, const struct bt_gatt_attr *attr
 static ssize_t read_status(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                            void *buf, uint16_t len, uint16_t offset)
 {
+    gatt_trace_read(attr, offset);
+
     uint8_t status = status_ptr->watering ? 1 : 0;
     LOG_INF("Read: Watering status = %u", status);
     return bt_gatt_attr_read(conn, attr, buf, len, offset, &status, sizeof(status));
@@ -70,6 +70,8 @@ static ssize_t read_status(struct bt_conn *conn, const struct bt_gatt_attr *attr
 static ssize_t read_last_watered(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                  void *buf, uint16_t len, uint16_t offset)
 {
+    gatt_trace_read(attr, offset);
+
     uint32_t now = k_uptime_get_32() / 1000; // Convert to seconds
     uint32_t since_seconds = now - status_ptr->last_watered_seconds;
     LOG_INF("Read: Time since last watering = %u seconds", since_seconds);
@@ -79,18 +81,66 @@ static ssize_t read_last_watered(struct bt_conn *conn, const struct bt_gatt_attr
 static ssize_t read_next_watered(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                  void *buf, uint16_t len, uint16_t offset)
 {
-    uint32_t now = k_uptime_get_32() / 1000; // Convert to seconds
-    uint32_t next_seconds = status_ptr->next_watering_seconds;
-    uint32_t time_until = next_seconds > now ? next_seconds - now : 0;
+    gatt_trace_read(attr, offset);
+
+    uint32_t time_until = schedule_time_until();
     LOG_INF("Read: Time until next watering = %u seconds", time_until);
     return bt_gatt_attr_read(conn, attr, buf, len, offset, &time_until, sizeof(time_until));
 }
 
+static ssize_t read_stats(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                          void *buf, uint16_t len, uint16_t offset)
+{
+    static uint8_t stats[WATERING_STATS_SERIALIZED_SIZE];
+    static size_t stats_len;
+
+    gatt_trace_read(attr, offset);
+    att_channels_mark_bulk();
+
+    // Keep the rollups stable across the reads of a long read
+    if (offset == 0)
+    {
+        stats_len = watering_stats_serialize(stats);
+        LOG_INF("Read: Watering stats (%zu bytes)", stats_len);
+    }
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, stats, stats_len);
+}
+
+static ssize_t read_schedule(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                             void *buf, uint16_t len, uint16_t offset)
+{
+    static uint8_t horizon[SCHEDULE_SERIALIZED_SIZE];
+    static size_t horizon_len;
+
+    gatt_trace_read(attr, offset);
+    att_channels_mark_bulk();
+
+    // Keep the horizon stable across the reads of a long read
+    if (offset == 0)
+    {
+        horizon_len = schedule_serialize(horizon, sizeof(horizon));
+        LOG_INF("Read: Schedule (%u waterings)", horizon[1]);
+    }
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, horizon, horizon_len);
+}
+
+static ssize_t read_pump_fault(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                               void *buf, uint16_t len, uint16_t offset)
+{
+    gatt_trace_read(attr, offset);
+
+    uint8_t fault = (uint8_t)status_ptr->fault;
+    LOG_INF("Read: Pump fault = %u", fault);
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &fault, sizeof(fault));
+}
+
 /* --- WRITE CALLBACKS --- */
 
 static ssize_t write_mode(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                           const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
 {
+    gatt_trace_write(attr, buf, len, offset);
+
     if (offset != 0 || len != 1)
     {
         return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
@@ -110,10 +160,17 @@ static ssize_t write_mode(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 static ssize_t write_interval(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                               const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
 {
+    gatt_trace_write(attr, buf, len, offset);
+
     if (offset != 0 || len != sizeof(cfg_ptr->interval_min))
     {
         return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
     }
+    // A zero interval would make every planned watering due at once
+    if (sys_get_le16(buf) == 0)
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
     cfg_ptr->interval_min = sys_get_le16(buf);
     LOG_INF("Write: Interval = %u min", cfg_ptr->interval_min);
     return len;
@@ -122,6 +179,8 @@ static ssize_t write_interval(struct bt_conn *conn, const struct bt_gatt_attr *a
 static ssize_t write_amount(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                             const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
 {
+    gatt_trace_write(attr, buf, len, offset);
+
     if (offset != 0 || len != sizeof(cfg_ptr->amount_ml))
     {
         return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
@@ -134,6 +193,8 @@ static ssize_t write_amount(struct bt_conn *conn, const struct bt_gatt_attr *att
 static ssize_t write_water_now(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
 {
+    gatt_trace_write(attr, buf, len, offset);
+
     if (offset != 0 || len != 1)
     {
         return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
@@ -152,22 +213,44 @@ static ssize_t write_water_now(struct bt_conn *conn, const struct bt_gatt_attr *
 
 static void status_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
 {
+    gatt_trace_ccc(attr, value);
+
     bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
     LOG_INF("Watering status notifications %s", notif_enabled ? "enabled" : "disabled");
 }
 
 static void last_watered_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
 {
+    gatt_trace_ccc(attr, value);
+
     bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
     LOG_INF("Last watered notifications %s", notif_enabled ? "enabled" : "disabled");
 }
 
 static void next_watered_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
 {
+    gatt_trace_ccc(attr, value);
+
     bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
     LOG_INF("Next watered notifications %s", notif_enabled ? "enabled" : "disabled");
 }
 
+static void schedule_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    gatt_trace_ccc(attr, value);
+
+    bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Schedule notifications %s", notif_enabled ? "enabled" : "disabled");
+}
+
+static void pump_fault_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    gatt_trace_ccc(attr, value);
+
+    bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Pump fault notifications %s", notif_enabled ? "enabled" : "disabled");
+}
+
 void notify_clients(const struct bt_gatt_attr *attr, const void *data, uint16_t len)
 {
     if (!current_conn)
@@ -195,6 +278,16 @@ void notify_clients(const struct bt_gatt_attr *attr, const void *data, uint16_t
         notify_attr = &watering_svc.attrs[NEXT_WATERING_ATTR_POS];
         char_name = "next watering";
     }
+    else if (attr == &watering_svc.attrs[PUMP_FAULT_ATTR_POS])
+    {
+        notify_attr = &watering_svc.attrs[PUMP_FAULT_ATTR_POS];
+        char_name = "pump fault";
+    }
+    else if (attr == &watering_svc.attrs[SCHEDULE_ATTR_POS])
+    {
+        notify_attr = &watering_svc.attrs[SCHEDULE_ATTR_POS];
+        char_name = "schedule";
+    }
 
     if (!notify_attr)
     {
@@ -211,7 +304,14 @@ void notify_clients(const struct bt_gatt_attr *attr, const void *data, uint16_t
 
     // Send notification
     LOG_INF("Sending notification for %s", char_name);
-    int err = bt_gatt_notify(current_conn, notify_attr, data, len);
+    struct bt_gatt_notify_params params = {
+        .attr = notify_attr,
+        .data = data,
+        .len = len,
+    };
+    att_channels_prepare_notify(current_conn, &params);
+
+    int err = bt_gatt_notify_cb(current_conn, &params);
     if (err)
     {
         LOG_ERR("Failed to send notification for %s (err %d)", char_name, err);
@@ -265,25 +365,60 @@ BT_GATT_SERVICE_DEFINE(watering_svc,
                                               read_next_watered, NULL, NULL),
 
                        BT_GATT_CCC(next_watered_ccc_cfg_changed,
+                                   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_AUTHEN),
+
+                       BT_GATT_CHARACTERISTIC(BT_UUID_WATERING_STATS,
+                                              BT_GATT_CHRC_READ,
+                                              BT_GATT_PERM_READ,
+                                              read_stats, NULL, NULL),
+
+                       BT_GATT_CHARACTERISTIC(BT_UUID_WATERING_FAULT,
+                                              BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                                              BT_GATT_PERM_READ,
+                                              read_pump_fault, NULL, NULL),
+
+                       BT_GATT_CCC(pump_fault_ccc_cfg_changed,
+                                   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_AUTHEN),
+
+                       BT_GATT_CHARACTERISTIC(BT_UUID_WATERING_SCHEDULE,
+                                              BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                                              BT_GATT_PERM_READ,
+                                              read_schedule, NULL, NULL),
+
+                       BT_GATT_CCC(schedule_ccc_cfg_changed,
                                    BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_AUTHEN));
 
 /* --- CONNECTION HANDLING --- */
-static int start_advertising()
-{
-    const struct bt_data ad[] = {
-        BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
-        BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1)};
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1)};
+
+static uint8_t fleet_beacon[FLEET_BEACON_LEN];
 
-    const struct bt_data sd[] = {
-        BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_WATERING_SERVICE_VAL)};
+static struct bt_data sd[] = {
+    BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_WATERING_SERVICE_VAL),
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, fleet_beacon, 0)};
 
-    int err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+// Refresh the fleet status beacon and return the number of scan response entries
+static size_t scan_response_update(void)
+{
+    sd[1].data_len = fleet_beacon_encode(cfg_ptr, status_ptr, fleet_beacon);
+    return sd[1].data_len ? ARRAY_SIZE(sd) : 1;
+}
+
+static int start_advertising()
+{
+    int err = bt_le_adv_start(BT_LE_ADV_PARAM(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME,
+                                              adv_interval_min, adv_interval_max, NULL),
+                              ad, ARRAY_SIZE(ad), sd, scan_response_update());
     if (err)
     {
         LOG_ERR("Advertising start failed (err %d)", err);
         return err;
     }
 
+    advertising = true;
+
     LOG_INF("Advertising started (device name: \"%s\")", CONFIG_BT_DEVICE_NAME);
     return 0;
 }
@@ -296,12 +431,25 @@ static void connected(struct bt_conn *conn, uint8_t err)
         return;
     }
 
+    // Links opened by this unit as a central (fleet gateway) are not ours
+    struct bt_conn_info info;
+    if (bt_conn_get_info(conn, &info) || info.role != BT_CONN_ROLE_PERIPHERAL)
+    {
+        return;
+    }
+
     LOG_INF("Bluetooth central connected");
     current_conn = conn;
+    advertising = false;
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
+    if (conn != current_conn)
+    {
+        return;
+    }
+
     LOG_INF("Bluetooth disconnected (reason %u)", reason);
     current_conn = NULL;
     start_advertising();
@@ -351,8 +499,77 @@ static void auth_cancel(struct bt_conn *conn)
 static struct bt_conn_auth_cb conn_auth_callbacks = {
 	.passkey_display = auth_passkey_display,
 	.cancel = auth_cancel,
+#if defined(CONFIG_WATERING_FLEET)
+	.pairing_accept = fleet_pairing_accept,
+#endif
 };
 
+bool bluetooth_is_connected(void)
+{
+    return current_conn != NULL;
+}
+
+uint16_t bluetooth_notify_max_len(void)
+{
+    return current_conn ? bt_gatt_get_mtu(current_conn) - 3 : 0;
+}
+
+int bluetooth_advertising_start(void)
+{
+    return start_advertising();
+}
+
+int bluetooth_advertising_stop(void)
+{
+    int err = bt_le_adv_stop();
+    if (err)
+    {
+        LOG_ERR("Advertising stop failed (err %d)", err);
+        return err;
+    }
+
+    advertising = false;
+
+    LOG_INF("Advertising stopped");
+    return 0;
+}
+
+int bluetooth_advertising_refresh(void)
+{
+    if (!advertising)
+    {
+        return 0;
+    }
+
+    int err = bt_le_adv_update_data(ad, ARRAY_SIZE(ad), sd, scan_response_update());
+    if (err)
+    {
+        LOG_ERR("Advertising data update failed (err %d)", err);
+        return err;
+    }
+    return 0;
+}
+
+int bluetooth_advertising_set_interval(uint16_t interval_min, uint16_t interval_max)
+{
+    adv_interval_min = interval_min;
+    adv_interval_max = interval_max;
+    LOG_INF("Advertising interval set to %u-%u", interval_min, interval_max);
+
+    // Restart a running advertiser so the new interval takes effect
+    if (!advertising)
+    {
+        return 0;
+    }
+
+    int err = bluetooth_advertising_stop();
+    if (err)
+    {
+        return err;
+    }
+    return start_advertising();
+}
+
 /* --- INIT FUNCTION --- */
 
 int bluetooth_init(struct plant_config *config, struct plant_status *status)
@@ -362,6 +579,12 @@ int bluetooth_init(struct plant_config *config, struct plant_status *status)
 
     LOG_INF("Watering Service starting...");
 
+    if (IS_ENABLED(CONFIG_WATERING_GATT_REPLAY))
+    {
+        LOG_INF("GATT replay - radio not enabled");
+        return 0;
+    }
+
     int err = bt_conn_auth_cb_register(&conn_auth_callbacks);
 	if (err) {
 		LOG_INF("Failed to register authorization callbacks");
@@ -1,8 +1,34 @@
 #ifndef BLUETOOTH_H
 #define BLUETOOTH_H
 #include "plant_common.h"
+#include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
 
+// Define 128-bit UUIDs for the custom service and its characteristics
+#define BT_UUID_WATERING_SERVICE_VAL BT_UUID_128_ENCODE(0xDEAD0000, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_MODE_VAL BT_UUID_128_ENCODE(0xDEAD0001, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_INTERVAL_VAL BT_UUID_128_ENCODE(0xDEAD0002, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_AMOUNT_VAL BT_UUID_128_ENCODE(0xDEAD0003, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_NOW_VAL BT_UUID_128_ENCODE(0xDEAD0004, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_STATUS_VAL BT_UUID_128_ENCODE(0xDEAD0005, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_LAST_VAL BT_UUID_128_ENCODE(0xDEAD0006, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_NEXT_VAL BT_UUID_128_ENCODE(0xDEAD0007, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_STATS_VAL BT_UUID_128_ENCODE(0xDEAD0008, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_FAULT_VAL BT_UUID_128_ENCODE(0xDEAD0009, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_WATERING_SCHEDULE_VAL BT_UUID_128_ENCODE(0xDEAD000A, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+
+#define BT_UUID_WATERING_SERVICE BT_UUID_DECLARE_128(BT_UUID_WATERING_SERVICE_VAL)
+#define BT_UUID_WATERING_MODE BT_UUID_DECLARE_128(BT_UUID_WATERING_MODE_VAL)
+#define BT_UUID_WATERING_INTERVAL BT_UUID_DECLARE_128(BT_UUID_WATERING_INTERVAL_VAL)
+#define BT_UUID_WATERING_AMOUNT BT_UUID_DECLARE_128(BT_UUID_WATERING_AMOUNT_VAL)
+#define BT_UUID_WATERING_NOW BT_UUID_DECLARE_128(BT_UUID_WATERING_NOW_VAL)
+#define BT_UUID_WATERING_STATUS BT_UUID_DECLARE_128(BT_UUID_WATERING_STATUS_VAL)
+#define BT_UUID_WATERING_LAST BT_UUID_DECLARE_128(BT_UUID_WATERING_LAST_VAL)
+#define BT_UUID_WATERING_NEXT BT_UUID_DECLARE_128(BT_UUID_WATERING_NEXT_VAL)
+#define BT_UUID_WATERING_STATS BT_UUID_DECLARE_128(BT_UUID_WATERING_STATS_VAL)
+#define BT_UUID_WATERING_FAULT BT_UUID_DECLARE_128(BT_UUID_WATERING_FAULT_VAL)
+#define BT_UUID_WATERING_SCHEDULE BT_UUID_DECLARE_128(BT_UUID_WATERING_SCHEDULE_VAL)
+
 // Forward declaration of the GATT service
 extern const struct bt_gatt_service_static watering_svc;
 
@@ -26,12 +52,22 @@ extern const struct bt_gatt_service_static watering_svc;
  * 15: Next Watering characteristic declaration
  * 16: Next Watering value (NEXT_WATERING_ATTR_POS)
  * 17: Next Watering CCC
+ * 18: Stats characteristic declaration
+ * 19: Stats value
+ * 20: Pump Fault characteristic declaration
+ * 21: Pump Fault value (PUMP_FAULT_ATTR_POS)
+ * 22: Pump Fault CCC
+ * 23: Schedule characteristic declaration
+ * 24: Schedule value (SCHEDULE_ATTR_POS)
+ * 25: Schedule CCC
  */
 enum watering_char_position
 {
     WATERING_STATUS_ATTR_POS = 10, // Status characteristic value
     LAST_WATERED_ATTR_POS = 13,    // Last watered characteristic value
-    NEXT_WATERING_ATTR_POS = 16    // Next watering characteristic value
+    NEXT_WATERING_ATTR_POS = 16,   // Next watering characteristic value
+    PUMP_FAULT_ATTR_POS = 21,      // Pump fault characteristic value
+    SCHEDULE_ATTR_POS = 24         // Schedule characteristic value
 };
 
 // Function to notify clients about characteristic changes
@@ -46,4 +82,52 @@ void notify_clients(const struct bt_gatt_attr *attr, const void *data, uint16_t
  */
 int bluetooth_init(struct plant_config *config, struct plant_status *status);
 
+/**
+ * @brief Check if a central is currently connected
+ *
+ * @return true if connected, false otherwise
+ */
+bool bluetooth_is_connected(void);
+
+/**
+ * @brief Get the largest notification the connected central can receive
+ *
+ * @return Maximum notification length in bytes, 0 if not connected
+ */
+uint16_t bluetooth_notify_max_len(void);
+
+/**
+ * @brief Start connectable advertising
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int bluetooth_advertising_start(void);
+
+/**
+ * @brief Stop advertising
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int bluetooth_advertising_stop(void);
+
+/**
+ * @brief Rebuild the advertising data from the current status
+ *
+ * Does nothing when not advertising.
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int bluetooth_advertising_refresh(void);
+
+/**
+ * @brief Set the advertising interval
+ *
+ * Applies immediately if advertising, otherwise the next time it starts.
+ *
+ * @param interval_min Minimum interval in 0.625 ms units
+ * @param interval_max Maximum interval in 0.625 ms units
+ * @return 0 on success, negative error code on failure
+ */
+int bluetooth_advertising_set_interval(uint16_t interval_min, uint16_t interval_max);
+
 #endif /* BLUETOOTH_H */
\ No newline at end of file
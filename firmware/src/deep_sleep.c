@@ -0,0 +1,258 @@
+#include "deep_sleep.h"
+#include "bluetooth.h"
+#include "motor_control.h"
+#include "plant_manager.h"
+#include "schedule.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/linker/section_tags.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/bluetooth/conn.h>
+
+LOG_MODULE_REGISTER(deep_sleep, LOG_LEVEL_INF);
+
+BUILD_ASSERT(CONFIG_WATERING_SLEEP_WAKE_MARGIN_S < CONFIG_WATERING_SLEEP_MIN_S,
+             "The wake margin must be shorter than the minimum sleep lead time");
+
+#define RETAINED_MAGIC 0x57415452 // "WATR"
+
+#define WAKE_BUTTON_NODE DT_ALIAS(sw0)
+#define CONSOLE_NODE DT_CHOSEN(zephyr_console)
+
+/* State kept in RAM that is not cleared at boot */
+struct retained_state
+{
+    uint32_t magic;
+    struct plant_config config;
+    uint32_t since_watered_seconds; ///< Time since last watering at snapshot
+    uint32_t next_in_seconds;       ///< Time until next watering at snapshot
+    uint32_t crc;
+};
+
+static __noinit struct retained_state retained;
+
+static struct plant_config *cfg;
+static struct plant_status *stat;
+
+static K_SEM_DEFINE(wake_sem, 0, 1);
+static int64_t awake_since_ms;
+static struct k_spinlock awake_lock;
+
+/* Sleep statistics */
+static uint32_t sleep_count;
+static uint32_t button_wake_count;
+static uint64_t total_sleep_ms;
+static uint64_t total_awake_ms;
+
+#if DT_NODE_HAS_STATUS(WAKE_BUTTON_NODE, okay)
+static const struct gpio_dt_spec wake_button = GPIO_DT_SPEC_GET(WAKE_BUTTON_NODE, gpios);
+static struct gpio_callback wake_button_cb;
+
+static void wake_button_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t pins)
+{
+    k_sem_give(&wake_sem);
+}
+
+static int wake_button_init(void)
+{
+    int err;
+
+    if (!gpio_is_ready_dt(&wake_button))
+    {
+        LOG_ERR("Wake button not ready");
+        return -ENODEV;
+    }
+
+    err = gpio_pin_configure_dt(&wake_button, GPIO_INPUT);
+    if (err)
+    {
+        LOG_ERR("Failed to configure wake button (err %d)", err);
+        return err;
+    }
+
+    err = gpio_pin_interrupt_configure_dt(&wake_button, GPIO_INT_EDGE_TO_ACTIVE);
+    if (err)
+    {
+        LOG_ERR("Failed to configure wake button interrupt (err %d)", err);
+        return err;
+    }
+
+    gpio_init_callback(&wake_button_cb, wake_button_pressed, BIT(wake_button.pin));
+    return gpio_add_callback(wake_button.port, &wake_button_cb);
+}
+#else
+static int wake_button_init(void)
+{
+    LOG_WRN("No sw0 alias - waking on the watering deadline only");
+    return 0;
+}
+#endif
+
+// Suspend or resume the console UART, which dominates idle current
+static void console_set_suspended(bool suspended)
+{
+#if defined(CONFIG_PM_DEVICE) && DT_NODE_EXISTS(CONSOLE_NODE)
+    const struct device *console = DEVICE_DT_GET(CONSOLE_NODE);
+
+    pm_device_action_run(console, suspended ? PM_DEVICE_ACTION_SUSPEND : PM_DEVICE_ACTION_RESUME);
+#endif
+}
+
+static uint32_t retained_crc(void)
+{
+    return crc32_ieee((const uint8_t *)&retained, offsetof(struct retained_state, crc));
+}
+
+// Snapshot config and schedule as relative times, so they survive an uptime reset
+static void retain_state(void)
+{
+    uint32_t now = k_uptime_get_32() / 1000;
+
+    retained.magic = RETAINED_MAGIC;
+    retained.config = *cfg;
+    retained.config.water_now = false;
+    retained.since_watered_seconds = now - stat->last_watered_seconds;
+    retained.next_in_seconds = schedule_time_until();
+    retained.crc = retained_crc();
+}
+
+// Add the time awake since the last mark to the statistics and restart the mark
+static int64_t awake_mark(void)
+{
+    int64_t now = k_uptime_get();
+    k_spinlock_key_t key = k_spin_lock(&awake_lock);
+
+    total_awake_ms += now - awake_since_ms;
+    awake_since_ms = now;
+
+    k_spin_unlock(&awake_lock, key);
+    return now;
+}
+
+// Time to sleep for, waking a margin ahead of a planned watering so the console
+// is back before the watering work runs
+static uint32_t sleep_duration_s(void)
+{
+    // Outside scheduled mode nothing is due, only the reachability bound applies
+    if (cfg->mode != PLANT_MODE_SCHEDULED)
+    {
+        return CONFIG_WATERING_SLEEP_MAX_S;
+    }
+
+    uint32_t until = schedule_time_until();
+    if (until < CONFIG_WATERING_SLEEP_MIN_S)
+    {
+        return 0;
+    }
+
+    return MIN(until - CONFIG_WATERING_SLEEP_WAKE_MARGIN_S, CONFIG_WATERING_SLEEP_MAX_S);
+}
+
+static bool can_sleep(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&awake_lock);
+    int64_t awake_ms = k_uptime_get() - awake_since_ms;
+    k_spin_unlock(&awake_lock, key);
+
+    if (bluetooth_is_connected() || motor_control_is_running())
+    {
+        return false;
+    }
+
+    if (awake_ms < CONFIG_WATERING_SLEEP_ADV_WINDOW_S * MSEC_PER_SEC)
+    {
+        return false;
+    }
+
+    return sleep_duration_s() > 0;
+}
+
+static void log_sleep_stats(bool by_button, uint32_t slept_ms)
+{
+    uint64_t total_ms = total_sleep_ms + total_awake_ms;
+    uint32_t avg_ua = total_ms ? (uint32_t)((total_sleep_ms * CONFIG_WATERING_SLEEP_CURRENT_UA +
+                                              total_awake_ms * CONFIG_WATERING_ACTIVE_CURRENT_UA) /
+                                             total_ms)
+                               : 0;
+
+    LOG_INF("Wake #%u (%s) after %u s, button wakes %u, asleep %u%%, avg current ~%u uA",
+            sleep_count, by_button ? "button" : "deadline", slept_ms / 1000,
+            button_wake_count, total_ms ? (uint32_t)(total_sleep_ms * 100 / total_ms) : 0,
+            avg_ua);
+}
+
+// Restart the advertising window after every disconnect, keeping the time
+// spent connected in the awake total
+static void deep_sleep_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    awake_mark();
+}
+
+BT_CONN_CB_DEFINE(deep_sleep_conn_cb) = {
+    .disconnected = deep_sleep_disconnected,
+};
+
+int deep_sleep_init(struct plant_config *config, struct plant_status *status)
+{
+    cfg = config;
+    stat = status;
+    awake_since_ms = k_uptime_get();
+
+    if (retained.magic == RETAINED_MAGIC && retained.crc == retained_crc())
+    {
+        uint32_t now = k_uptime_get_32() / 1000;
+
+        LOG_INF("Restoring state from retained RAM");
+        *cfg = retained.config;
+        stat->last_watered_seconds = now - retained.since_watered_seconds;
+        plant_manager_restore(retained.next_in_seconds);
+    }
+    else
+    {
+        LOG_INF("No retained state - cold start");
+    }
+
+    return wake_button_init();
+}
+
+void deep_sleep_check(void)
+{
+    retain_state();
+
+    if (!can_sleep())
+    {
+        return;
+    }
+
+    uint32_t sleep_s = sleep_duration_s();
+    int64_t start_ms = awake_mark();
+
+    LOG_INF("Entering deep sleep for up to %u s", sleep_s);
+    bluetooth_advertising_stop();
+    console_set_suspended(true);
+
+    // The watering work item would still fire on its RTC deadline while we block
+    // here, but the wake margin has us awake with the console back by then
+    k_sem_reset(&wake_sem);
+    bool by_button = k_sem_take(&wake_sem, K_SECONDS(sleep_s)) == 0;
+
+    console_set_suspended(false);
+
+    uint32_t slept_ms = (uint32_t)(k_uptime_get() - start_ms);
+    total_sleep_ms += slept_ms;
+    sleep_count++;
+    if (by_button)
+    {
+        button_wake_count++;
+    }
+    log_sleep_stats(by_button, slept_ms);
+
+    // Time asleep is not awake time
+    k_spinlock_key_t key = k_spin_lock(&awake_lock);
+    awake_since_ms = k_uptime_get();
+    k_spin_unlock(&awake_lock, key);
+
+    bluetooth_advertising_start();
+}
@@ -0,0 +1,42 @@
+#ifndef DEEP_SLEEP_H
+#define DEEP_SLEEP_H
+
+#include "plant_common.h"
+
+#if defined(CONFIG_WATERING_DEEP_SLEEP)
+
+/**
+ * @brief Initialize deep sleep and restore retained state
+ *
+ * If retained RAM holds a valid snapshot from before a reset, the
+ * configuration, status and next deadline are restored and the schedule
+ * is continued. Must be called after plant_manager_init().
+ *
+ * @param config Pointer to plant configuration
+ * @param status Pointer to plant status
+ * @return 0 on success, negative error code on failure
+ */
+int deep_sleep_init(struct plant_config *config, struct plant_status *status);
+
+/**
+ * @brief Call periodically to retain state and enter deep sleep when idle
+ *
+ * Blocks the caller while asleep. Returns after waking on the watering
+ * deadline or the wake button, with advertising resumed.
+ */
+void deep_sleep_check(void);
+
+#else
+
+static inline int deep_sleep_init(struct plant_config *config, struct plant_status *status)
+{
+    return 0;
+}
+
+static inline void deep_sleep_check(void)
+{
+}
+
+#endif /* CONFIG_WATERING_DEEP_SLEEP */
+
+#endif /* DEEP_SLEEP_H */
@@ -0,0 +1,163 @@
+#include "dfu.h"
+#include "motor_control.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/dfu/mcuboot.h>
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt.h>
+#include <zephyr/mgmt/mcumgr/mgmt/callbacks.h>
+#include <zephyr/mgmt/mcumgr/grp/img_mgmt/img_mgmt.h>
+
+LOG_MODULE_REGISTER(dfu, LOG_LEVEL_INF);
+
+static atomic_t transfer_active;
+static int64_t transfer_start_ms;
+static size_t transfer_size;
+static size_t transfer_received;
+
+/* Stop the pump and hold watering off until the transfer ends */
+static void dfu_transfer_started(void)
+{
+    atomic_set(&transfer_active, 1);
+
+    if (motor_control_is_running())
+    {
+        LOG_WRN("Stopping pump for firmware update");
+        motor_control_stop();
+    }
+}
+
+/* Log the time spent on the transfer so fleet rollout time can be predicted */
+static void dfu_transfer_finished(bool complete)
+{
+    uint32_t elapsed_ms = (uint32_t)(k_uptime_get() - transfer_start_ms);
+
+    atomic_set(&transfer_active, 0);
+
+    if (!complete)
+    {
+        LOG_WRN("Image transfer aborted after %zu/%zu bytes (%u ms)",
+                transfer_received, transfer_size, elapsed_ms);
+        return;
+    }
+
+    uint32_t rate = elapsed_ms ? (uint32_t)((uint64_t)transfer_received * 1000 / elapsed_ms) : 0;
+    LOG_INF("Image transfer complete: %zu bytes in %u ms (%u B/s)",
+            transfer_received, elapsed_ms, rate);
+}
+
+static enum mgmt_cb_return dfu_mgmt_event(uint32_t event, enum mgmt_cb_return prev_status,
+                                          int32_t *rc, uint16_t *group, bool *abort_more,
+                                          void *data, size_t data_size)
+{
+    switch (event)
+    {
+    case MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK:
+    {
+        const struct img_mgmt_upload_check *check = data;
+
+        if (check->req->off == 0)
+        {
+            transfer_start_ms = k_uptime_get();
+            transfer_size = check->req->size;
+            LOG_INF("Image transfer started: %zu bytes", transfer_size);
+        }
+        transfer_received = check->req->off + check->req->img_data.len;
+        break;
+    }
+    case MGMT_EVT_OP_IMG_MGMT_DFU_STARTED:
+        dfu_transfer_started();
+        break;
+    case MGMT_EVT_OP_IMG_MGMT_DFU_PENDING:
+        dfu_transfer_finished(true);
+        break;
+    case MGMT_EVT_OP_IMG_MGMT_DFU_STOPPED:
+        dfu_transfer_finished(false);
+        break;
+    case MGMT_EVT_OP_OS_MGMT_RESET:
+        // Never reboot into the swap with the pump on
+        LOG_INF("Reset requested - stopping pump");
+        motor_control_stop();
+        break;
+    default:
+        break;
+    }
+
+    return MGMT_CB_OK;
+}
+
+static struct mgmt_callback img_mgmt_cb = {
+    .callback = dfu_mgmt_event,
+    .event_id = MGMT_EVT_OP_IMG_MGMT_ALL,
+};
+
+static struct mgmt_callback os_mgmt_cb = {
+    .callback = dfu_mgmt_event,
+    .event_id = MGMT_EVT_OP_OS_MGMT_RESET,
+};
+
+/* --- LINK TUNING --- */
+
+// Ask for 2M PHY and maximum data length on every new connection
+static void dfu_connected(struct bt_conn *conn, uint8_t err)
+{
+    if (err)
+    {
+        return;
+    }
+
+    err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (err)
+    {
+        LOG_WRN("PHY update request failed (err %d)", err);
+    }
+
+    err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (err)
+    {
+        LOG_WRN("Data length update request failed (err %d)", err);
+    }
+}
+
+static void dfu_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+    LOG_INF("PHY updated: TX %u, RX %u", param->tx_phy, param->rx_phy);
+}
+
+static void dfu_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+    LOG_INF("Data length updated: TX %u bytes, RX %u bytes", info->tx_max_len, info->rx_max_len);
+}
+
+BT_CONN_CB_DEFINE(dfu_conn_cb) = {
+    .connected = dfu_connected,
+    .le_phy_updated = dfu_phy_updated,
+    .le_data_len_updated = dfu_data_len_updated,
+};
+
+/* --- INIT FUNCTION --- */
+
+int dfu_init(void)
+{
+    if (!boot_is_img_confirmed())
+    {
+        int err = boot_write_img_confirmed();
+        if (err)
+        {
+            LOG_ERR("Failed to confirm image (err %d)", err);
+            return err;
+        }
+        LOG_INF("Running image confirmed");
+    }
+
+    mgmt_callback_register(&img_mgmt_cb);
+    mgmt_callback_register(&os_mgmt_cb);
+
+    LOG_INF("Firmware update over SMP ready");
+    return 0;
+}
+
+bool dfu_in_progress(void)
+{
+    return atomic_get(&transfer_active);
+}
@@ -0,0 +1,42 @@
+#ifndef DFU_H
+#define DFU_H
+
+#include <stdbool.h>
+
+#if defined(CONFIG_WATERING_DFU)
+
+/**
+ * @brief Initialize over-the-air firmware update support
+ *
+ * This function:
+ * - Confirms the running image if it was booted for test after a swap
+ * - Registers the MCUmgr hooks that keep the pump off during a transfer
+ *
+ * Should be called once the rest of the system came up successfully.
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int dfu_init(void);
+
+/**
+ * @brief Check if an image transfer is in progress
+ *
+ * @return true while an image is being uploaded, false otherwise
+ */
+bool dfu_in_progress(void);
+
+#else
+
+static inline int dfu_init(void)
+{
+    return 0;
+}
+
+static inline bool dfu_in_progress(void)
+{
+    return false;
+}
+
+#endif /* CONFIG_WATERING_DFU */
+
+#endif /* DFU_H */
@@ -0,0 +1,196 @@
+#include "energy.h"
+#include "bluetooth.h"
+#include "motor_control.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/voltage_divider.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/services/bas.h>
+
+LOG_MODULE_REGISTER(energy, LOG_LEVEL_INF);
+
+/* Level above a threshold needed to move back up a tier */
+#define TIER_HYSTERESIS_PCT 5
+
+/* Retry delay for a sample skipped because the pump was loading the battery */
+#define PUMP_RETRY_S 10
+
+static const struct voltage_divider_dt_spec vbatt =
+    VOLTAGE_DIVIDER_DT_SPEC_GET(DT_NODELABEL(vbatt));
+
+/**
+ * @brief Behaviour applied in each energy tier
+ */
+struct energy_policy
+{
+    const char *name;
+    uint16_t adv_interval_min; ///< Advertising interval in 0.625 ms units
+    uint16_t adv_interval_max;
+    uint8_t notify_divisor; ///< Ticks between periodic notifications
+    bool defer_background;  ///< Postpone non-critical work
+    bool allow_watering;    ///< Pump may run
+};
+
+static const struct energy_policy policies[] = {
+    [ENERGY_TIER_NORMAL] = {"NORMAL", BT_GAP_ADV_FAST_INT_MIN_2, BT_GAP_ADV_FAST_INT_MAX_2, 1, false, true},
+    [ENERGY_TIER_LOW] = {"LOW", BT_GAP_ADV_SLOW_INT_MIN, BT_GAP_ADV_SLOW_INT_MAX, 4, true, true},
+    [ENERGY_TIER_CRITICAL] = {"CRITICAL", 0x0fa0, 0x12c0, 20, true, false}, // 2.5 s - 3 s
+};
+
+static struct adc_sequence sequence;
+static int16_t sample;
+static energy_tier_t tier = ENERGY_TIER_NORMAL;
+
+static struct k_work_delayable sample_work;
+
+static int battery_read_mv(int32_t *mv)
+{
+    int err = adc_read_dt(&vbatt.port, &sequence);
+    if (err)
+    {
+        return err;
+    }
+
+    *mv = sample;
+    err = adc_raw_to_millivolts_dt(&vbatt.port, mv);
+    if (err)
+    {
+        return err;
+    }
+
+    return voltage_divider_scale_dt(&vbatt, mv);
+}
+
+static uint8_t battery_level_pct(int32_t mv)
+{
+    if (mv <= CONFIG_WATERING_BATTERY_EMPTY_MV)
+    {
+        return 0;
+    }
+    if (mv >= CONFIG_WATERING_BATTERY_FULL_MV)
+    {
+        return 100;
+    }
+    return (uint8_t)((mv - CONFIG_WATERING_BATTERY_EMPTY_MV) * 100 /
+                     (CONFIG_WATERING_BATTERY_FULL_MV - CONFIG_WATERING_BATTERY_EMPTY_MV));
+}
+
+// Pick the tier for a level, only moving up once clear of the threshold
+static energy_tier_t tier_for_level(uint8_t level)
+{
+    uint8_t low = CONFIG_WATERING_ENERGY_LOW_PCT;
+    uint8_t cutoff = CONFIG_WATERING_ENERGY_CUTOFF_PCT;
+
+    if (tier > ENERGY_TIER_NORMAL)
+    {
+        low += TIER_HYSTERESIS_PCT;
+    }
+    if (tier > ENERGY_TIER_LOW)
+    {
+        cutoff += TIER_HYSTERESIS_PCT;
+    }
+
+    if (level < cutoff)
+    {
+        return ENERGY_TIER_CRITICAL;
+    }
+    if (level < low)
+    {
+        return ENERGY_TIER_LOW;
+    }
+    return ENERGY_TIER_NORMAL;
+}
+
+static void apply_tier(energy_tier_t new_tier, int32_t mv, uint8_t level)
+{
+    const struct energy_policy *policy = &policies[new_tier];
+
+    LOG_INF("Energy tier %s -> %s at %u s (battery %d mV, %u%%)",
+            policies[tier].name, policy->name, k_uptime_get_32() / 1000, mv, level);
+
+    tier = new_tier;
+    bluetooth_advertising_set_interval(policy->adv_interval_min, policy->adv_interval_max);
+}
+
+static void energy_sample(struct k_work *work)
+{
+    int32_t mv;
+
+    // The pump makes the battery sag, which would drop the tier and then defer
+    // or block the watering that caused it; keep the tier until it stops
+    if (motor_control_is_running())
+    {
+        LOG_DBG("Pump running - battery sample skipped");
+        k_work_reschedule(&sample_work, K_SECONDS(PUMP_RETRY_S));
+        return;
+    }
+
+    int err = battery_read_mv(&mv);
+
+    if (err)
+    {
+        LOG_ERR("Battery read failed (err %d)", err);
+    }
+    else
+    {
+        uint8_t level = battery_level_pct(mv);
+        energy_tier_t new_tier = tier_for_level(level);
+
+        LOG_DBG("Battery %d mV, %u%%", mv, level);
+        bt_bas_set_battery_level(level);
+
+        if (new_tier != tier)
+        {
+            apply_tier(new_tier, mv, level);
+        }
+    }
+
+    k_work_reschedule(&sample_work, K_SECONDS(CONFIG_WATERING_BATTERY_SAMPLE_S));
+}
+
+int energy_init(void)
+{
+    int err;
+
+    if (!adc_is_ready_dt(&vbatt.port))
+    {
+        LOG_ERR("Battery ADC not ready");
+        return -ENODEV;
+    }
+
+    err = adc_channel_setup_dt(&vbatt.port);
+    if (err)
+    {
+        LOG_ERR("Failed to set up battery ADC channel (err %d)", err);
+        return err;
+    }
+
+    sequence.buffer = &sample;
+    sequence.buffer_size = sizeof(sample);
+    err = adc_sequence_init_dt(&vbatt.port, &sequence);
+    if (err)
+    {
+        LOG_ERR("Failed to initialize battery ADC sequence (err %d)", err);
+        return err;
+    }
+
+    k_work_init_delayable(&sample_work, energy_sample);
+    k_work_schedule(&sample_work, K_NO_WAIT);
+    return 0;
+}
+
+bool energy_watering_allowed(void)
+{
+    return policies[tier].allow_watering;
+}
+
+uint8_t energy_notify_divisor(void)
+{
+    return policies[tier].notify_divisor;
+}
+
+bool energy_defer_background(void)
+{
+    return policies[tier].defer_background;
+}
@@ -0,0 +1,78 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Energy budget tiers
+ *
+ * NORMAL: Full advertising and notification rate
+ * LOW: Stretched advertising/notifications, background work deferred
+ * CRITICAL: As LOW with longer intervals, and watering is refused
+ */
+typedef enum
+{
+    ENERGY_TIER_NORMAL = 0,
+    ENERGY_TIER_LOW = 1,
+    ENERGY_TIER_CRITICAL = 2,
+} energy_tier_t;
+
+#if defined(CONFIG_WATERING_ENERGY)
+
+/**
+ * @brief Initialize battery sampling and the energy budget policy
+ *
+ * Takes a first battery sample, applies the matching tier and starts
+ * periodic sampling.
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int energy_init(void);
+
+/**
+ * @brief Check if the battery allows running the pump
+ *
+ * @return false below the cutoff level, true otherwise
+ */
+bool energy_watering_allowed(void);
+
+/**
+ * @brief Number of ticks between periodic (non event driven) notifications
+ *
+ * @return 1 at full budget, larger as the battery drains
+ */
+uint8_t energy_notify_divisor(void);
+
+/**
+ * @brief Check if non-critical background work should be postponed
+ *
+ * @return true when the battery is low
+ */
+bool energy_defer_background(void);
+
+#else
+
+static inline int energy_init(void)
+{
+    return 0;
+}
+
+static inline bool energy_watering_allowed(void)
+{
+    return true;
+}
+
+static inline uint8_t energy_notify_divisor(void)
+{
+    return 1;
+}
+
+static inline bool energy_defer_background(void)
+{
+    return false;
+}
+
+#endif /* CONFIG_WATERING_ENERGY */
+
+#endif /* ENERGY_H */
@@ -0,0 +1,199 @@
+#include "fleet.h"
+#include "bluetooth.h"
+#include "schedule.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/conn.h>
+
+LOG_MODULE_REGISTER(fleet, LOG_LEVEL_INF);
+
+BUILD_ASSERT(CONFIG_WATERING_FLEET_PASSKEY >= 0,
+             "Set CONFIG_WATERING_FLEET_PASSKEY to the six digit passkey of this installation");
+
+/* IO capability the gateway pairs with (Core Spec Vol 3, Part H, 3.5.1) */
+#define IO_KEYBOARD_ONLY 0x02
+
+static struct k_work_delayable beacon_work;
+
+/* Longest lockout after repeated failed gateway pairings */
+#define FLEET_PAIR_BACKOFF_MAX_S (24 * 3600)
+
+/* Peer being paired. The stack has a single fixed passkey, so only one peer
+ * pairs at a time. Only touched from Bluetooth callbacks.
+ */
+static struct bt_conn *pairing_conn;
+static bool pairing_gateway;
+
+/* Gateway allowed to pair with the fleet passkey, and its failed attempts */
+static bt_addr_le_t gateway_addr;
+static uint32_t failed_attempts;
+static int64_t locked_until_ms;
+
+static uint16_t minutes_saturated(uint32_t seconds)
+{
+    return (uint16_t)MIN(seconds / 60, UINT16_MAX - 1);
+}
+
+size_t fleet_beacon_encode(const struct plant_config *config, const struct plant_status *status,
+                           uint8_t *buf)
+{
+    uint32_t now = k_uptime_get_32() / 1000;
+    uint16_t next_min = FLEET_NEXT_NONE;
+
+    if (config->mode == PLANT_MODE_SCHEDULED)
+    {
+        next_min = minutes_saturated(schedule_time_until());
+    }
+
+    sys_put_le16(FLEET_COMPANY_ID, &buf[0]);
+    buf[2] = FLEET_BEACON_MAGIC;
+    buf[3] = (uint8_t)config->mode;
+    buf[4] = (status->watering ? FLEET_FLAG_WATERING : 0) |
+             ((uint8_t)status->fault << FLEET_FLAG_FAULT_SHIFT);
+    sys_put_le16(minutes_saturated(now - status->last_watered_seconds), &buf[5]);
+    sys_put_le16(next_min, &buf[7]);
+
+    return FLEET_BEACON_LEN;
+}
+
+// Work handler pushing the current status into the scan response
+static void beacon_refresh(struct k_work *work)
+{
+    bluetooth_advertising_refresh();
+    k_work_schedule(&beacon_work, K_SECONDS(CONFIG_WATERING_FLEET_BEACON_S));
+}
+
+/* --- PAIRING --- */
+
+// Whether this pairing may use the fleet passkey: only the allow-listed gateway,
+// outside a lockout
+static bool fleet_passkey_allowed(struct bt_conn *conn, const struct bt_conn_pairing_feat *feat)
+{
+    char addr[BT_ADDR_LE_STR_LEN];
+
+    if (feat->io_capability != IO_KEYBOARD_ONLY)
+    {
+        return false;
+    }
+
+    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+
+    if (!bt_addr_le_eq(bt_conn_get_dst(conn), &gateway_addr))
+    {
+        LOG_WRN("Keyboard-only peer %s is not the fleet gateway", addr);
+        return false;
+    }
+
+    if (k_uptime_get() < locked_until_ms)
+    {
+        LOG_WRN("Fleet pairing locked for %lld s after failed attempts",
+                (locked_until_ms - k_uptime_get()) / MSEC_PER_SEC);
+        return false;
+    }
+
+    return true;
+}
+
+enum bt_security_err fleet_pairing_accept(struct bt_conn *conn,
+                                          const struct bt_conn_pairing_feat *const feat)
+{
+    if (pairing_conn && pairing_conn != conn)
+    {
+        LOG_WRN("Pairing already in progress - request rejected");
+        return BT_SECURITY_ERR_UNSPECIFIED;
+    }
+
+    // Everyone else, phones included, gets a random displayed passkey
+    bool gateway = fleet_passkey_allowed(conn, feat);
+    int err = bt_passkey_set(gateway ? CONFIG_WATERING_FLEET_PASSKEY : BT_PASSKEY_INVALID);
+    if (err)
+    {
+        LOG_ERR("Failed to set pairing passkey (err %d)", err);
+        return BT_SECURITY_ERR_UNSPECIFIED;
+    }
+
+    pairing_conn = conn;
+    pairing_gateway = gateway;
+    LOG_INF("Pairing with %s", gateway ? "fleet gateway" : "random passkey");
+    return BT_SECURITY_ERR_SUCCESS;
+}
+
+// Back to random passkeys once the paired peer is done
+static void pairing_done(struct bt_conn *conn)
+{
+    if (conn != pairing_conn)
+    {
+        return;
+    }
+
+    pairing_conn = NULL;
+    pairing_gateway = false;
+    bt_passkey_set(BT_PASSKEY_INVALID);
+}
+
+static void pairing_complete(struct bt_conn *conn, bool bonded)
+{
+    if (conn == pairing_conn && pairing_gateway)
+    {
+        failed_attempts = 0;
+    }
+    pairing_done(conn);
+}
+
+// A failed passkey entry leaks part of the passkey, so back off exponentially
+static void pairing_failed(struct bt_conn *conn, enum bt_security_err reason)
+{
+    if (conn == pairing_conn && pairing_gateway)
+    {
+        uint32_t lock_s = MIN(CONFIG_WATERING_FLEET_PAIR_BACKOFF_S << MIN(failed_attempts, 16),
+                              FLEET_PAIR_BACKOFF_MAX_S);
+
+        failed_attempts++;
+        locked_until_ms = k_uptime_get() + (int64_t)lock_s * MSEC_PER_SEC;
+        LOG_WRN("Fleet pairing failed (%u in a row) - locked for %u s", failed_attempts, lock_s);
+    }
+    pairing_done(conn);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    pairing_done(conn);
+}
+
+static struct bt_conn_auth_info_cb pairing_info_callbacks = {
+    .pairing_complete = pairing_complete,
+    .pairing_failed = pairing_failed,
+};
+
+BT_CONN_CB_DEFINE(fleet_pairing_conn_cb) = {
+    .disconnected = disconnected,
+};
+
+int fleet_init(void)
+{
+    int err = bt_addr_le_from_str(CONFIG_WATERING_FLEET_GATEWAY_ADDR, "random", &gateway_addr);
+    if (err)
+    {
+        // Without a gateway the fleet passkey is never offered, the beacon still runs
+        bt_addr_le_copy(&gateway_addr, BT_ADDR_LE_NONE);
+        if (!IS_ENABLED(CONFIG_WATERING_FLEET_GATEWAY))
+        {
+            LOG_WRN("No valid CONFIG_WATERING_FLEET_GATEWAY_ADDR - forwarded commands cannot pair");
+        }
+    }
+
+    err = bt_conn_auth_info_cb_register(&pairing_info_callbacks);
+    if (err)
+    {
+        LOG_ERR("Failed to register pairing callbacks (err %d)", err);
+        return err;
+    }
+
+    k_work_init_delayable(&beacon_work, beacon_refresh);
+    k_work_schedule(&beacon_work, K_SECONDS(CONFIG_WATERING_FLEET_BEACON_S));
+
+    LOG_INF("Fleet beacon every %u s", CONFIG_WATERING_FLEET_BEACON_S);
+
+    return fleet_gateway_init();
+}
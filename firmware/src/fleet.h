@@ -0,0 +1,99 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "plant_common.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/conn.h>
+
+/* Status beacon carried as manufacturer data in the scan response:
+ * 0-1: Company ID (0xFFFF, reserved for testing)
+ * 2:   Magic (FLEET_BEACON_MAGIC)
+ * 3:   Mode (plant_mode_t)
+ * 4:   Flags (bit 0 watering, bits 1-2 pump fault)
+ * 5-6: Minutes since last watering (uint16, saturating)
+ * 7-8: Minutes to next watering (uint16, FLEET_NEXT_NONE if not scheduled)
+ */
+#define FLEET_COMPANY_ID 0xFFFF
+#define FLEET_BEACON_MAGIC 0x57
+#define FLEET_STATUS_LEN 6
+#define FLEET_BEACON_LEN (3 + FLEET_STATUS_LEN)
+#define FLEET_NEXT_NONE 0xFFFF
+
+#define FLEET_FLAG_WATERING BIT(0)
+#define FLEET_FLAG_FAULT_SHIFT 1
+
+#if defined(CONFIG_WATERING_FLEET)
+
+/**
+ * @brief Encode the status beacon for the scan response
+ *
+ * @param config Pointer to plant configuration
+ * @param status Pointer to plant status
+ * @param buf    Output buffer of at least FLEET_BEACON_LEN bytes
+ * @return Number of bytes written
+ */
+size_t fleet_beacon_encode(const struct plant_config *config, const struct plant_status *status,
+                           uint8_t *buf);
+
+/**
+ * @brief Choose the passkey for an incoming pairing request
+ *
+ * Used as the pairing_accept authentication callback. A keyboard-only
+ * peer using CONFIG_WATERING_FLEET_GATEWAY_ADDR pairs with the fleet
+ * passkey, unless locked out after failed attempts; any other peer with a
+ * random displayed passkey.
+ *
+ * @param conn Connection being paired
+ * @param feat Pairing features requested by the peer
+ * @return BT_SECURITY_ERR_SUCCESS to accept, an error to reject
+ */
+enum bt_security_err fleet_pairing_accept(struct bt_conn *conn,
+                                          const struct bt_conn_pairing_feat *const feat);
+
+/**
+ * @brief Initialize fleet mode
+ *
+ * Starts refreshing the status beacon and, on a gateway, starts
+ * collecting the neighbours' beacons. Must be called after
+ * bluetooth_init().
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int fleet_init(void);
+
+#else
+
+static inline size_t fleet_beacon_encode(const struct plant_config *config,
+                                         const struct plant_status *status, uint8_t *buf)
+{
+    return 0;
+}
+
+static inline int fleet_init(void)
+{
+    return 0;
+}
+
+#endif /* CONFIG_WATERING_FLEET */
+
+#if defined(CONFIG_WATERING_FLEET_GATEWAY)
+
+/**
+ * @brief Start scanning for neighbours and serve the Fleet service
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int fleet_gateway_init(void);
+
+#else
+
+static inline int fleet_gateway_init(void)
+{
+    return 0;
+}
+
+#endif /* CONFIG_WATERING_FLEET_GATEWAY */
+
+#endif /* FLEET_H */
@@ -0,0 +1,598 @@
+#include "fleet.h"
+#include "bluetooth.h"
+#include "att_channels.h"
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/att.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/hci.h>
+
+LOG_MODULE_REGISTER(fleet_gateway, LOG_LEVEL_INF);
+
+#define BT_UUID_FLEET_SERVICE_VAL BT_UUID_128_ENCODE(0xDEAD0200, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_FLEET_UNITS_VAL BT_UUID_128_ENCODE(0xDEAD0201, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_FLEET_COMMAND_VAL BT_UUID_128_ENCODE(0xDEAD0202, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+
+#define BT_UUID_FLEET_SERVICE BT_UUID_DECLARE_128(BT_UUID_FLEET_SERVICE_VAL)
+#define BT_UUID_FLEET_UNITS BT_UUID_DECLARE_128(BT_UUID_FLEET_UNITS_VAL)
+#define BT_UUID_FLEET_COMMAND BT_UUID_DECLARE_128(BT_UUID_FLEET_COMMAND_VAL)
+
+/* Passive-leaning active scan: 30 ms window every 100 ms, for scan responses */
+#define FLEET_SCAN_INTERVAL 0x00A0
+#define FLEET_SCAN_WINDOW 0x0030
+
+/* Units table: version, count, then per unit address, status, RSSI and age */
+#define FLEET_TABLE_VERSION 1
+#define FLEET_TABLE_HEADER_LEN 2
+#define FLEET_ENTRY_LEN (sizeof(bt_addr_le_t) + FLEET_STATUS_LEN + 1 + 2)
+#define FLEET_TABLE_MAX_LEN (FLEET_TABLE_HEADER_LEN + CONFIG_WATERING_FLEET_MAX_UNITS * FLEET_ENTRY_LEN)
+
+BUILD_ASSERT(FLEET_TABLE_MAX_LEN <= BT_ATT_MAX_ATTRIBUTE_LEN, "Fleet table exceeds one attribute");
+
+/* Command: target address, characteristic, then its value */
+#define FLEET_CMD_HEADER_LEN (sizeof(bt_addr_le_t) + 1)
+#define FLEET_CMD_MAX_VALUE 2
+
+/**
+ * @brief Characteristic a forwarded command writes on the target unit
+ */
+enum fleet_cmd_target
+{
+    FLEET_CMD_MODE = 1,
+    FLEET_CMD_INTERVAL = 2,
+    FLEET_CMD_AMOUNT = 3,
+    FLEET_CMD_WATER_NOW = 4,
+};
+
+/* Watering characteristic and value length for each command target */
+static const struct bt_uuid_128 cmd_uuids[] = {
+    [FLEET_CMD_MODE] = BT_UUID_INIT_128(BT_UUID_WATERING_MODE_VAL),
+    [FLEET_CMD_INTERVAL] = BT_UUID_INIT_128(BT_UUID_WATERING_INTERVAL_VAL),
+    [FLEET_CMD_AMOUNT] = BT_UUID_INIT_128(BT_UUID_WATERING_AMOUNT_VAL),
+    [FLEET_CMD_WATER_NOW] = BT_UUID_INIT_128(BT_UUID_WATERING_NOW_VAL),
+};
+
+static const uint8_t cmd_value_len[] = {
+    [FLEET_CMD_MODE] = 1,
+    [FLEET_CMD_INTERVAL] = 2,
+    [FLEET_CMD_AMOUNT] = 2,
+    [FLEET_CMD_WATER_NOW] = 1,
+};
+
+/**
+ * @brief State of the last forwarded command
+ */
+enum fleet_cmd_state
+{
+    FLEET_CMD_IDLE = 0,
+    FLEET_CMD_BUSY = 1,
+    FLEET_CMD_DONE = 2,
+    FLEET_CMD_FAILED = 3,
+};
+
+/**
+ * @brief Neighbour seen in a status beacon
+ */
+struct fleet_unit
+{
+    bt_addr_le_t addr;
+    uint8_t status[FLEET_STATUS_LEN]; ///< Beacon status bytes, as received
+    int8_t rssi;
+    uint32_t seen_s; ///< Uptime when last heard
+    bool used;
+};
+
+static struct fleet_unit units[CONFIG_WATERING_FLEET_MAX_UNITS];
+static struct k_spinlock units_lock;
+
+/* Forwarded command in progress. Written from the Bluetooth RX thread and used
+ * from the system workqueue, so a new command is only accepted under cmd_lock
+ * and once the previous one has released the link.
+ */
+static struct
+{
+    bt_addr_le_t addr;
+    uint8_t target;
+    uint8_t value[FLEET_CMD_MAX_VALUE];
+    uint8_t len;
+    uint8_t state;
+    int8_t err;
+    bool active; ///< From the write until the link to the target is gone
+} cmd;
+static struct k_spinlock cmd_lock;
+
+static struct bt_conn *cmd_conn;
+static struct k_work cmd_work;
+static struct k_work_delayable cmd_timeout_work;
+static struct bt_gatt_discover_params discover_params;
+static struct bt_gatt_write_params write_params;
+
+static void scan_start(void);
+
+/* --- NEIGHBOUR TABLE --- */
+
+static bool unit_is_fresh(const struct fleet_unit *unit, uint32_t now)
+{
+    return unit->used && now - unit->seen_s < CONFIG_WATERING_FLEET_STALE_S;
+}
+
+// Find the entry for a neighbour, or the one to reuse: a stale entry, else the oldest
+static struct fleet_unit *unit_slot(const bt_addr_le_t *addr, uint32_t now)
+{
+    struct fleet_unit *oldest = &units[0];
+    struct fleet_unit *stale = NULL;
+
+    for (size_t i = 0; i < ARRAY_SIZE(units); i++)
+    {
+        struct fleet_unit *unit = &units[i];
+
+        if (unit->used && bt_addr_le_eq(&unit->addr, addr))
+        {
+            return unit;
+        }
+        if (!stale && !unit_is_fresh(unit, now))
+        {
+            stale = unit;
+        }
+        if (unit->seen_s < oldest->seen_s)
+        {
+            oldest = unit;
+        }
+    }
+    return stale ? stale : oldest;
+}
+
+/**
+ * @brief Result of parsing a scan response
+ */
+struct beacon_parse
+{
+    uint8_t status[FLEET_STATUS_LEN];
+    bool found;
+};
+
+static bool parse_beacon(struct bt_data *data, void *user_data)
+{
+    struct beacon_parse *beacon = user_data;
+
+    if (data->type != BT_DATA_MANUFACTURER_DATA || data->data_len != FLEET_BEACON_LEN ||
+        sys_get_le16(data->data) != FLEET_COMPANY_ID || data->data[2] != FLEET_BEACON_MAGIC)
+    {
+        return true;
+    }
+
+    memcpy(beacon->status, &data->data[3], FLEET_STATUS_LEN);
+    beacon->found = true;
+    return false;
+}
+
+// Scan callback; status beacons are carried in the scan response
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+                         struct net_buf_simple *ad)
+{
+    struct beacon_parse beacon = {0};
+
+    if (type != BT_GAP_ADV_TYPE_SCAN_RSP)
+    {
+        return;
+    }
+
+    bt_data_parse(ad, parse_beacon, &beacon);
+    if (!beacon.found)
+    {
+        return;
+    }
+
+    uint32_t now = k_uptime_get_32() / 1000;
+    k_spinlock_key_t key = k_spin_lock(&units_lock);
+
+    struct fleet_unit *unit = unit_slot(addr, now);
+    bool joined = !unit->used || !bt_addr_le_eq(&unit->addr, addr);
+
+    bt_addr_le_copy(&unit->addr, addr);
+    memcpy(unit->status, beacon.status, FLEET_STATUS_LEN);
+    unit->rssi = rssi;
+    unit->seen_s = now;
+    unit->used = true;
+
+    k_spin_unlock(&units_lock, key);
+
+    if (joined)
+    {
+        char addr_str[BT_ADDR_LE_STR_LEN];
+
+        bt_addr_le_to_str(addr, addr_str, sizeof(addr_str));
+        LOG_INF("Fleet unit %s joined", addr_str);
+    }
+}
+
+static size_t units_serialize(uint8_t *buf)
+{
+    uint32_t now = k_uptime_get_32() / 1000;
+    uint8_t *p = &buf[FLEET_TABLE_HEADER_LEN];
+    uint8_t count = 0;
+
+    k_spinlock_key_t key = k_spin_lock(&units_lock);
+
+    for (size_t i = 0; i < ARRAY_SIZE(units); i++)
+    {
+        const struct fleet_unit *unit = &units[i];
+
+        if (!unit_is_fresh(unit, now))
+        {
+            continue;
+        }
+
+        memcpy(p, &unit->addr, sizeof(unit->addr));
+        p += sizeof(unit->addr);
+        memcpy(p, unit->status, FLEET_STATUS_LEN);
+        p += FLEET_STATUS_LEN;
+        *p++ = (uint8_t)unit->rssi;
+        sys_put_le16((uint16_t)(now - unit->seen_s), p);
+        p += 2;
+        count++;
+    }
+
+    k_spin_unlock(&units_lock, key);
+
+    buf[0] = FLEET_TABLE_VERSION;
+    buf[1] = count;
+    return p - buf;
+}
+
+/* --- COMMAND FORWARDING --- */
+
+static void notify_command(void);
+
+// Accept new commands again and go back to scanning
+static void cmd_release(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&cmd_lock);
+    cmd.active = false;
+    k_spin_unlock(&cmd_lock, key);
+
+    scan_start();
+}
+
+static void cmd_finish(int err)
+{
+    k_spinlock_key_t key = k_spin_lock(&cmd_lock);
+
+    // The timeout and the link callbacks can race to finish the same command
+    if (cmd.state != FLEET_CMD_BUSY)
+    {
+        k_spin_unlock(&cmd_lock, key);
+        return;
+    }
+    cmd.state = err ? FLEET_CMD_FAILED : FLEET_CMD_DONE;
+    cmd.err = (int8_t)err;
+    k_spin_unlock(&cmd_lock, key);
+
+    k_work_cancel_delayable(&cmd_timeout_work);
+
+    LOG_INF("Fleet command %s (err %d)", err ? "failed" : "done", err);
+    notify_command();
+
+    // Scanning resumes once the link to the target is gone
+    if (cmd_conn)
+    {
+        bt_conn_disconnect(cmd_conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    }
+    else
+    {
+        cmd_release();
+    }
+}
+
+static void cmd_write_done(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+    cmd_finish(err ? -EIO : 0);
+}
+
+static uint8_t cmd_discovered(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                              struct bt_gatt_discover_params *params)
+{
+    if (!attr)
+    {
+        cmd_finish(-ENOENT);
+        return BT_GATT_ITER_STOP;
+    }
+
+    const struct bt_gatt_chrc *chrc = attr->user_data;
+
+    write_params.func = cmd_write_done;
+    write_params.handle = chrc->value_handle;
+    write_params.offset = 0;
+    write_params.data = cmd.value;
+    write_params.length = cmd.len;
+
+    int err = bt_gatt_write(conn, &write_params);
+    if (err)
+    {
+        cmd_finish(err);
+    }
+    return BT_GATT_ITER_STOP;
+}
+
+static void cmd_passkey_entry(struct bt_conn *conn)
+{
+    bt_conn_auth_passkey_entry(conn, CONFIG_WATERING_FLEET_PASSKEY);
+}
+
+static void cmd_auth_cancel(struct bt_conn *conn)
+{
+    LOG_WRN("Fleet pairing cancelled");
+}
+
+// Keyboard-only on links to neighbours, which is how they recognise the gateway and
+// display the fleet passkey rather than a random one
+static const struct bt_conn_auth_cb cmd_auth_callbacks = {
+    .passkey_entry = cmd_passkey_entry,
+    .cancel = cmd_auth_cancel,
+};
+
+// Work handler connecting to the target of a new command
+static void cmd_start(struct k_work *work)
+{
+    int err = bt_le_scan_stop();
+    if (err && err != -EALREADY)
+    {
+        LOG_WRN("Failed to stop scanning (err %d)", err);
+    }
+
+    err = bt_conn_le_create(&cmd.addr, BT_CONN_LE_CREATE_CONN, BT_LE_CONN_PARAM_DEFAULT, &cmd_conn);
+    if (err)
+    {
+        LOG_ERR("Failed to connect to fleet unit (err %d)", err);
+        cmd_finish(err);
+        return;
+    }
+
+    k_work_schedule(&cmd_timeout_work, K_SECONDS(CONFIG_WATERING_FLEET_CMD_TIMEOUT_S));
+}
+
+static void cmd_timeout(struct k_work *work)
+{
+    LOG_WRN("Fleet command timed out");
+    cmd_finish(-ETIMEDOUT);
+}
+
+// Drop the link to the target; finishes a command it cut short, otherwise releases it
+static void cmd_link_closed(void)
+{
+    bt_conn_unref(cmd_conn);
+    cmd_conn = NULL;
+
+    if (cmd.state == FLEET_CMD_BUSY)
+    {
+        cmd_finish(-ENOTCONN);
+    }
+    else
+    {
+        cmd_release();
+    }
+}
+
+static void fleet_connected(struct bt_conn *conn, uint8_t err)
+{
+    if (conn != cmd_conn)
+    {
+        return;
+    }
+
+    if (err)
+    {
+        cmd_link_closed();
+        return;
+    }
+
+    // Watering characteristics need an authenticated link
+    int rc = bt_conn_auth_cb_overlay(conn, &cmd_auth_callbacks);
+    if (!rc)
+    {
+        rc = bt_conn_set_security(conn, BT_SECURITY_L3);
+    }
+    if (rc)
+    {
+        cmd_finish(rc);
+    }
+}
+
+static void fleet_security_changed(struct bt_conn *conn, bt_security_t level,
+                                   enum bt_security_err err)
+{
+    if (conn != cmd_conn || cmd.state != FLEET_CMD_BUSY)
+    {
+        return;
+    }
+
+    if (err || level < BT_SECURITY_L3)
+    {
+        cmd_finish(-EACCES);
+        return;
+    }
+
+    discover_params.uuid = &cmd_uuids[cmd.target].uuid;
+    discover_params.func = cmd_discovered;
+    discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+    int rc = bt_gatt_discover(conn, &discover_params);
+    if (rc)
+    {
+        cmd_finish(rc);
+    }
+}
+
+static void fleet_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    if (conn != cmd_conn)
+    {
+        return;
+    }
+
+    cmd_link_closed();
+}
+
+BT_CONN_CB_DEFINE(fleet_conn_cb) = {
+    .connected = fleet_connected,
+    .disconnected = fleet_disconnected,
+    .security_changed = fleet_security_changed,
+};
+
+/* --- GATT SERVICE --- */
+
+static ssize_t read_units(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                          void *buf, uint16_t len, uint16_t offset)
+{
+    static uint8_t table[FLEET_TABLE_MAX_LEN];
+    static size_t table_len;
+
+    att_channels_mark_bulk();
+
+    // Keep the table stable across the reads of a long read
+    if (offset == 0)
+    {
+        table_len = units_serialize(table);
+        LOG_INF("Read: Fleet units (%u units)", table[1]);
+    }
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, table, table_len);
+}
+
+static void command_result(uint8_t *result)
+{
+    k_spinlock_key_t key = k_spin_lock(&cmd_lock);
+
+    result[0] = cmd.state;
+    result[1] = (uint8_t)cmd.err;
+    memcpy(&result[2], &cmd.addr, sizeof(cmd.addr));
+
+    k_spin_unlock(&cmd_lock, key);
+}
+
+static ssize_t read_command(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                            void *buf, uint16_t len, uint16_t offset)
+{
+    uint8_t result[2 + sizeof(bt_addr_le_t)];
+
+    command_result(result);
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, result, sizeof(result));
+}
+
+static ssize_t write_command(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                             const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+
+    if (offset != 0 || len <= FLEET_CMD_HEADER_LEN)
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    uint8_t target = data[sizeof(bt_addr_le_t)];
+    if (target < FLEET_CMD_MODE || target > FLEET_CMD_WATER_NOW)
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    if (len != FLEET_CMD_HEADER_LEN + cmd_value_len[target])
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&cmd_lock);
+
+    // One forward at a time, until its link is closed
+    if (cmd.active)
+    {
+        k_spin_unlock(&cmd_lock, key);
+        return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+    }
+
+    memcpy(&cmd.addr, data, sizeof(cmd.addr));
+    cmd.target = target;
+    memcpy(cmd.value, &data[FLEET_CMD_HEADER_LEN], cmd_value_len[target]);
+    cmd.len = cmd_value_len[target];
+    cmd.state = FLEET_CMD_BUSY;
+    cmd.err = 0;
+    cmd.active = true;
+
+    k_spin_unlock(&cmd_lock, key);
+
+    LOG_INF("Write: Fleet command %u", target);
+    k_work_submit(&cmd_work);
+    return len;
+}
+
+static void command_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Fleet command notifications %s", notif_enabled ? "enabled" : "disabled");
+}
+
+BT_GATT_SERVICE_DEFINE(fleet_svc,
+                       BT_GATT_PRIMARY_SERVICE(BT_UUID_FLEET_SERVICE),
+
+                       BT_GATT_CHARACTERISTIC(BT_UUID_FLEET_UNITS,
+                                              BT_GATT_CHRC_READ,
+                                              BT_GATT_PERM_READ,
+                                              read_units, NULL, NULL),
+
+                       BT_GATT_CHARACTERISTIC(BT_UUID_FLEET_COMMAND,
+                                              BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+                                                  BT_GATT_CHRC_NOTIFY,
+                                              BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_AUTHEN,
+                                              read_command, write_command, NULL),
+
+                       BT_GATT_CCC(command_ccc_cfg_changed,
+                                   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_AUTHEN));
+
+// Notify subscribed phones of the command result (value of attribute 4)
+static void notify_command(void)
+{
+    uint8_t result[2 + sizeof(bt_addr_le_t)];
+
+    command_result(result);
+    bt_gatt_notify(NULL, &fleet_svc.attrs[4], result, sizeof(result));
+}
+
+/* --- INIT FUNCTION --- */
+
+static void scan_start(void)
+{
+    int err = bt_le_scan_start(BT_LE_SCAN_PARAM(BT_LE_SCAN_TYPE_ACTIVE, BT_LE_SCAN_OPT_NONE,
+                                                FLEET_SCAN_INTERVAL, FLEET_SCAN_WINDOW),
+                               device_found);
+    if (err && err != -EALREADY)
+    {
+        LOG_ERR("Fleet scan start failed (err %d)", err);
+    }
+}
+
+int fleet_gateway_init(void)
+{
+    k_work_init(&cmd_work, cmd_start);
+    k_work_init_delayable(&cmd_timeout_work, cmd_timeout);
+
+    scan_start();
+
+    // Members only accept the fleet passkey from this address
+    bt_addr_le_t id;
+    size_t count = 1;
+    char addr[BT_ADDR_LE_STR_LEN];
+
+    bt_id_get(&id, &count);
+    if (count > 0)
+    {
+        bt_addr_le_to_str(&id, addr, sizeof(addr));
+        LOG_INF("Fleet gateway identity %s - use it for CONFIG_WATERING_FLEET_GATEWAY_ADDR", addr);
+    }
+
+    LOG_INF("Fleet gateway scanning, up to %u units", CONFIG_WATERING_FLEET_MAX_UNITS);
+    return 0;
+}
@@ -0,0 +1,243 @@
+#include "gatt_replay.h"
+#include "gatt_trace.h"
+#include "bluetooth.h"
+#include "plant_manager.h"
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#if !defined(CONFIG_NATIVE_LIBRARY)
+#include <zephyr/timing/timing.h>
+#endif
+
+LOG_MODULE_REGISTER(gatt_replay, LOG_LEVEL_INF);
+
+#define TICK_PERIOD_MS 500 // Same cadence as the main loop
+#define MAX_ATTRS 32
+
+static const uint8_t trace[] = {
+#include "gatt_trace.inc"
+};
+
+/**
+ * @brief Accumulated cost of one kind of operation on one attribute
+ */
+struct replay_cost
+{
+    uint32_t count;
+    uint64_t callback_ns;
+    uint64_t callback_max;
+    uint64_t reaction_ns;
+    uint64_t reaction_max;
+};
+
+static struct replay_cost costs[GATT_TRACE_OP_COUNT][MAX_ATTRS];
+
+static const char *const op_names[GATT_TRACE_OP_COUNT] = {"read", "write", "ccc"};
+
+/* --- CLOCK --- */
+
+#if defined(CONFIG_NATIVE_LIBRARY)
+
+/* Simulated time does not advance while code runs, so on native_sim the
+ * callbacks are timed on the host monotonic clock (gatt_replay_host.c).
+ */
+uint64_t gatt_replay_host_ns(void);
+
+static void clock_init(void)
+{
+}
+
+static void clock_stop(void)
+{
+}
+
+static uint64_t clock_now(void)
+{
+    return gatt_replay_host_ns();
+}
+
+static uint64_t clock_elapsed_ns(uint64_t start, uint64_t end)
+{
+    return end - start;
+}
+
+#else
+
+static void clock_init(void)
+{
+    timing_init();
+    timing_start();
+}
+
+static void clock_stop(void)
+{
+    timing_stop();
+}
+
+static uint64_t clock_now(void)
+{
+    return timing_counter_get();
+}
+
+static uint64_t clock_elapsed_ns(uint64_t start, uint64_t end)
+{
+    timing_t from = start;
+    timing_t to = end;
+
+    return timing_cycles_to_ns(timing_cycles_get(&from, &to));
+}
+
+#endif /* CONFIG_NATIVE_LIBRARY */
+
+/* --- REPLAY --- */
+
+static void dispatch(gatt_trace_op_t op, const struct bt_gatt_attr *attr, uint16_t offset,
+                     const uint8_t *data, uint8_t len)
+{
+    uint8_t buf[CONFIG_BT_L2CAP_TX_MTU];
+
+    switch (op)
+    {
+    case GATT_TRACE_OP_READ:
+        if (attr->read)
+        {
+            attr->read(NULL, attr, buf, sizeof(buf), 0);
+        }
+        break;
+    case GATT_TRACE_OP_WRITE:
+        if (attr->write)
+        {
+            attr->write(NULL, attr, data, len, offset, 0);
+        }
+        break;
+    case GATT_TRACE_OP_CCC:
+    {
+        // Only a CCC descriptor carries a struct _bt_gatt_ccc as user data
+        if (bt_uuid_cmp(attr->uuid, BT_UUID_GATT_CCC) != 0)
+        {
+            LOG_WRN("CCC record for a non-CCC attribute, skipped");
+            break;
+        }
+
+        const struct _bt_gatt_ccc *ccc = attr->user_data;
+        if (ccc->cfg_changed && len == sizeof(uint16_t))
+        {
+            ccc->cfg_changed(attr, sys_get_le16(data));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Run one record and the plant manager tick reacting to it, timing both
+static void replay_record(gatt_trace_op_t op, uint8_t index, uint16_t offset,
+                          const uint8_t *data, uint8_t len)
+{
+    struct replay_cost *cost = &costs[op][index];
+    uint64_t start, ns;
+
+    start = clock_now();
+    dispatch(op, &watering_svc.attrs[index], offset, data, len);
+    ns = clock_elapsed_ns(start, clock_now());
+    cost->callback_ns += ns;
+    cost->callback_max = MAX(cost->callback_max, ns);
+
+    start = clock_now();
+    plant_manager_tick();
+    ns = clock_elapsed_ns(start, clock_now());
+    cost->reaction_ns += ns;
+    cost->reaction_max = MAX(cost->reaction_max, ns);
+
+    cost->count++;
+}
+
+static void report(void)
+{
+    LOG_INF("%-5s %4s %6s %12s %12s %12s %12s", "op", "attr", "count",
+            "cb avg ns", "cb max ns", "react avg ns", "react max ns");
+
+    for (int op = 0; op < GATT_TRACE_OP_COUNT; op++)
+    {
+        for (int i = 0; i < MAX_ATTRS; i++)
+        {
+            const struct replay_cost *cost = &costs[op][i];
+            if (cost->count == 0)
+            {
+                continue;
+            }
+
+            LOG_INF("%-5s %4d %6u %12llu %12llu %12llu %12llu", op_names[op], i, cost->count,
+                    cost->callback_ns / cost->count, cost->callback_max,
+                    cost->reaction_ns / cost->count, cost->reaction_max);
+        }
+    }
+}
+
+int gatt_replay_run(void)
+{
+    size_t pos = GATT_TRACE_MAGIC_LEN;
+    uint32_t records = 0;
+    uint32_t trace_start_ms = 0;
+    int64_t replay_start_ms = k_uptime_get();
+    int64_t next_tick_ms = replay_start_ms;
+
+    if (sizeof(trace) < GATT_TRACE_MAGIC_LEN || memcmp(trace, GATT_TRACE_MAGIC, GATT_TRACE_MAGIC_LEN) != 0)
+    {
+        LOG_ERR("Embedded GATT trace is invalid");
+        return -EINVAL;
+    }
+
+    clock_init();
+
+    LOG_INF("Replaying %zu byte GATT trace", sizeof(trace));
+
+    while (pos + GATT_TRACE_RECORD_HDR_LEN <= sizeof(trace))
+    {
+        const uint8_t *rec = &trace[pos];
+        uint32_t time_ms = sys_get_le32(&rec[0]);
+        gatt_trace_op_t op = rec[4];
+        uint8_t index = rec[5];
+        uint16_t offset = sys_get_le16(&rec[6]);
+        uint8_t len = rec[8];
+
+        if (pos + GATT_TRACE_RECORD_HDR_LEN + len > sizeof(trace))
+        {
+            LOG_WRN("Trace truncated at offset %zu", pos);
+            break;
+        }
+        pos += GATT_TRACE_RECORD_HDR_LEN + len;
+
+        if (op >= GATT_TRACE_OP_COUNT || index >= MIN(watering_svc.attr_count, MAX_ATTRS))
+        {
+            LOG_WRN("Skipping invalid record (op %u, attr %u)", op, index);
+            continue;
+        }
+
+        if (records == 0)
+        {
+            trace_start_ms = time_ms;
+        }
+
+        // Keep the main loop cadence running until the record is due
+        int64_t due_ms = replay_start_ms + (time_ms - trace_start_ms);
+        while (next_tick_ms <= due_ms)
+        {
+            k_sleep(K_TIMEOUT_ABS_MS(next_tick_ms));
+            plant_manager_tick();
+            next_tick_ms += TICK_PERIOD_MS;
+        }
+        k_sleep(K_TIMEOUT_ABS_MS(due_ms));
+
+        replay_record(op, index, offset, &rec[GATT_TRACE_RECORD_HDR_LEN], len);
+        records++;
+    }
+
+    clock_stop();
+
+    LOG_INF("Replayed %u records", records);
+    report();
+    return 0;
+}
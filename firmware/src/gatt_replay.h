@@ -0,0 +1,29 @@
+#ifndef GATT_REPLAY_H
+#define GATT_REPLAY_H
+
+#include <errno.h>
+
+#if defined(CONFIG_WATERING_GATT_REPLAY)
+
+/**
+ * @brief Replay the embedded GATT trace through the watering service
+ *
+ * Feeds every recorded read, write and CCC change straight into the GATT
+ * callbacks, at the recorded times and with the main loop tick running in
+ * between, then logs the time spent per callback and per plant manager
+ * reaction.
+ *
+ * @return 0 on success, negative error code if the trace is invalid
+ */
+int gatt_replay_run(void);
+
+#else
+
+static inline int gatt_replay_run(void)
+{
+    return -ENOTSUP;
+}
+
+#endif /* CONFIG_WATERING_GATT_REPLAY */
+
+#endif /* GATT_REPLAY_H */
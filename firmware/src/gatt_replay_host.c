@@ -0,0 +1,13 @@
+/* Host side of the GATT replayer on native_sim, built into the native simulator
+ * runner rather than the embedded image so it can use the host C library.
+ */
+#include <stdint.h>
+#include <time.h>
+
+uint64_t gatt_replay_host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,107 @@
+#include "gatt_trace.h"
+#include "bluetooth.h"
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/shell/shell.h>
+
+LOG_MODULE_REGISTER(gatt_trace, LOG_LEVEL_INF);
+
+/* Capture stops when the buffer is full, so a trace always replays from its start */
+static uint8_t trace_buf[CONFIG_WATERING_GATT_TRACE_SIZE];
+static size_t trace_len;
+static bool trace_full;
+static struct k_spinlock lock;
+
+static void trace_record(gatt_trace_op_t op, const struct bt_gatt_attr *attr, uint16_t offset,
+                         const void *data, uint8_t len)
+{
+    uint8_t index = (uint8_t)(attr - watering_svc.attrs);
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (trace_len == 0)
+    {
+        memcpy(trace_buf, GATT_TRACE_MAGIC, GATT_TRACE_MAGIC_LEN);
+        trace_len = GATT_TRACE_MAGIC_LEN;
+    }
+
+    if (trace_len + GATT_TRACE_RECORD_HDR_LEN + len > sizeof(trace_buf))
+    {
+        if (!trace_full)
+        {
+            trace_full = true;
+            LOG_WRN("GATT trace buffer full - capture stopped");
+        }
+        k_spin_unlock(&lock, key);
+        return;
+    }
+
+    uint8_t *rec = &trace_buf[trace_len];
+    sys_put_le32(k_uptime_get_32(), &rec[0]);
+    rec[4] = op;
+    rec[5] = index;
+    sys_put_le16(offset, &rec[6]);
+    rec[8] = len;
+    if (len > 0)
+    {
+        memcpy(&rec[GATT_TRACE_RECORD_HDR_LEN], data, len);
+    }
+    trace_len += GATT_TRACE_RECORD_HDR_LEN + len;
+
+    k_spin_unlock(&lock, key);
+}
+
+void gatt_trace_read(const struct bt_gatt_attr *attr, uint16_t offset)
+{
+    if (offset == 0)
+    {
+        trace_record(GATT_TRACE_OP_READ, attr, 0, NULL, 0);
+    }
+}
+
+void gatt_trace_write(const struct bt_gatt_attr *attr, const void *buf, uint16_t len, uint16_t offset)
+{
+    // Prepared (offset) writes are rejected by the handlers, record them as-is
+    trace_record(GATT_TRACE_OP_WRITE, attr, offset, buf, (uint8_t)MIN(len, UINT8_MAX));
+}
+
+void gatt_trace_ccc(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    uint8_t data[2];
+
+    sys_put_le16(value, data);
+    trace_record(GATT_TRACE_OP_CCC, attr, 0, data, sizeof(data));
+}
+
+/* --- SHELL COMMANDS --- */
+
+static int cmd_trace_dump(const struct shell *sh, size_t argc, char **argv)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    size_t len = trace_len;
+    k_spin_unlock(&lock, key);
+
+    // Records are only appended, so the first len bytes are stable
+    shell_print(sh, "GATT trace: %zu bytes%s", len, trace_full ? " (full)" : "");
+    shell_hexdump(sh, trace_buf, len);
+    return 0;
+}
+
+static int cmd_trace_clear(const struct shell *sh, size_t argc, char **argv)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    trace_len = 0;
+    trace_full = false;
+    k_spin_unlock(&lock, key);
+
+    shell_print(sh, "GATT trace cleared");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_gatt_trace,
+                               SHELL_CMD(dump, NULL, "Print the captured trace as hex", cmd_trace_dump),
+                               SHELL_CMD(clear, NULL, "Discard the captured trace", cmd_trace_clear),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(gatt_trace, &sub_gatt_trace, "GATT traffic capture", NULL);
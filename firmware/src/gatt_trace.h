@@ -0,0 +1,78 @@
+#ifndef GATT_TRACE_H
+#define GATT_TRACE_H
+
+#include <stdint.h>
+#include <zephyr/bluetooth/gatt.h>
+
+/* Trace layout (little endian):
+ * header: magic "GTR2" (4 bytes)
+ * record: time in ms since boot (uint32), operation (uint8),
+ *         watering service attribute index (uint8), offset (uint16),
+ *         data length (uint8), data
+ *
+ * READ records carry no data, WRITE records the written bytes at their
+ * offset and CCC records the new CCC value (uint16).
+ */
+#define GATT_TRACE_MAGIC "GTR2"
+#define GATT_TRACE_MAGIC_LEN 4
+#define GATT_TRACE_RECORD_HDR_LEN 9
+
+/**
+ * @brief Traced GATT operations
+ */
+typedef enum
+{
+    GATT_TRACE_OP_READ = 0,
+    GATT_TRACE_OP_WRITE = 1,
+    GATT_TRACE_OP_CCC = 2,
+    GATT_TRACE_OP_COUNT,
+} gatt_trace_op_t;
+
+#if defined(CONFIG_WATERING_GATT_TRACE)
+
+/**
+ * @brief Record a characteristic read handled by the watering service
+ *
+ * Only the first read (offset 0) of a long read is recorded.
+ *
+ * @param attr   Attribute being read
+ * @param offset Read offset
+ */
+void gatt_trace_read(const struct bt_gatt_attr *attr, uint16_t offset);
+
+/**
+ * @brief Record a characteristic write handled by the watering service
+ *
+ * @param attr   Attribute being written
+ * @param buf    Written data
+ * @param len    Length of the written data
+ * @param offset Write offset
+ */
+void gatt_trace_write(const struct bt_gatt_attr *attr, const void *buf, uint16_t len, uint16_t offset);
+
+/**
+ * @brief Record a CCC change of the watering service
+ *
+ * @param attr  CCC attribute
+ * @param value New CCC value
+ */
+void gatt_trace_ccc(const struct bt_gatt_attr *attr, uint16_t value);
+
+#else
+
+static inline void gatt_trace_read(const struct bt_gatt_attr *attr, uint16_t offset)
+{
+}
+
+static inline void gatt_trace_write(const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+                                    uint16_t offset)
+{
+}
+
+static inline void gatt_trace_ccc(const struct bt_gatt_attr *attr, uint16_t value)
+{
+}
+
+#endif /* CONFIG_WATERING_GATT_TRACE */
+
+#endif /* GATT_TRACE_H */
@@ -1,5 +1,11 @@
 #include "bluetooth.h"
 #include "plant_manager.h"
+#include "dfu.h"
+#include "deep_sleep.h"
+#include "mem_diag.h"
+#include "energy.h"
+#include "fleet.h"
+#include "gatt_replay.h"
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
@@ -15,7 +21,8 @@ static struct plant_config config = {
 /* System status */
 static struct plant_status status = {
     .last_watered_seconds = 0, // Never watered
-    .watering = false          // Not watering
+    .watering = false,         // Not watering
+    .fault = PUMP_FAULT_NONE   // No pump fault
 };
 
 int main(void)
@@ -42,14 +49,61 @@ int main(void)
     }
     LOG_INF("Plant Manager initialized successfully");
 
+    /* Initialize firmware update (confirms this image once the system is up) */
+    err = dfu_init();
+    if (err)
+    {
+        LOG_ERR("Failed to initialize firmware update (err %d)", err);
+        return err;
+    }
+
+    /* Initialize deep sleep (restores retained state after a reset) */
+    err = deep_sleep_init(&config, &status);
+    if (err)
+    {
+        LOG_ERR("Failed to initialize deep sleep (err %d)", err);
+        return err;
+    }
+
+    /* Initialize memory diagnostics */
+    err = mem_diag_init();
+    if (err)
+    {
+        LOG_ERR("Failed to initialize memory diagnostics (err %d)", err);
+        return err;
+    }
+
+    /* Initialize battery monitoring and energy budget */
+    err = energy_init();
+    if (err)
+    {
+        LOG_ERR("Failed to initialize energy budget (err %d)", err);
+        return err;
+    }
+
+    /* Initialize fleet beacon (and gateway role) */
+    err = fleet_init();
+    if (err)
+    {
+        LOG_ERR("Failed to initialize fleet mode (err %d)", err);
+        return err;
+    }
+
     LOG_INF("System ready! Current mode: %s",
             config.mode == PLANT_MODE_OFF ? "OFF" : config.mode == PLANT_MODE_MANUAL ? "MANUAL"
                                                                                      : "SCHEDULED");
 
+    /* Replay a captured GATT trace instead of serving the radio */
+    if (IS_ENABLED(CONFIG_WATERING_GATT_REPLAY))
+    {
+        return gatt_replay_run();
+    }
+
     /* Main loop */
     while (1)
     {
         plant_manager_tick();
+        deep_sleep_check();
         k_sleep(K_MSEC(500));
     }
 
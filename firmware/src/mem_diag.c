@@ -0,0 +1,284 @@
+#include "mem_diag.h"
+#include "att_channels.h"
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/sys_heap.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/shell/shell.h>
+
+LOG_MODULE_REGISTER(mem_diag, LOG_LEVEL_INF);
+
+#define BT_UUID_DIAG_SERVICE_VAL BT_UUID_128_ENCODE(0xDEAD0100, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+#define BT_UUID_DIAG_MEMORY_VAL BT_UUID_128_ENCODE(0xDEAD0101, 0xC634, 0x45D2, 0xA209, 0xC636967B81B2)
+
+#define BT_UUID_DIAG_SERVICE BT_UUID_DECLARE_128(BT_UUID_DIAG_SERVICE_VAL)
+#define BT_UUID_DIAG_MEMORY BT_UUID_DECLARE_128(BT_UUID_DIAG_MEMORY_VAL)
+
+#define MAX_THREADS 12
+#define MAX_POOLS 8
+#define MAX_MSGQS 4
+#define MAX_HEAPS 2
+#define NAME_LEN 8
+
+/* Characteristic layout (little endian):
+ * header: version, flags, thread count, pool count, msgq count, heap count (6 x uint8),
+ *         pool/msgq sampling period in ms (uint16)
+ * thread: name[8], stack size (uint16), stack peak (uint16)
+ * pool:   name[8], buffer count (uint16), peak used (uint16)
+ * msgq:   max messages (uint16), peak used (uint16)
+ * heap:   size (uint32), peak allocated (uint32)
+ *
+ * Pool and msgq peaks are sampled, so they are lower bounds: a burst between
+ * two samples is not seen. Stack and heap peaks are exact high-water marks.
+ */
+#define MEM_DIAG_VERSION 2
+#define MEM_DIAG_HDR_LEN 8
+#define MEM_DIAG_BUF_SIZE (MEM_DIAG_HDR_LEN + MAX_THREADS * 12 + MAX_POOLS * 12 + MAX_MSGQS * 4 + MAX_HEAPS * 8)
+
+/* Header flags */
+#define MEM_DIAG_FLAG_SAMPLED BIT(0)          ///< Pool and msgq peaks are sampled lower bounds
+#define MEM_DIAG_FLAG_THREADS_TRUNCATED BIT(1) ///< More threads than MAX_THREADS
+#define MEM_DIAG_FLAG_POOLS_TRUNCATED BIT(2)   ///< More pools than MAX_POOLS
+#define MEM_DIAG_FLAG_MSGQS_TRUNCATED BIT(3)   ///< More message queues than MAX_MSGQS
+#define MEM_DIAG_FLAG_HEAPS_TRUNCATED BIT(4)   ///< More heaps than MAX_HEAPS
+
+static uint16_t pool_peak[MAX_POOLS];
+static uint32_t msgq_peak[MAX_MSGQS];
+
+static struct k_work_delayable sample_work;
+
+/* --- SAMPLING --- */
+
+static uint16_t pool_used(struct net_buf_pool *pool)
+{
+    return pool->buf_count - (uint16_t)atomic_get(&pool->avail_count);
+}
+
+// Pools and queues only know current usage, so record the highest seen. Bursts
+// shorter than the sampling period are missed, the peaks are lower bounds
+static void sample_peaks(struct k_work *work)
+{
+    int i = 0;
+
+    STRUCT_SECTION_FOREACH(net_buf_pool, pool)
+    {
+        if (i >= MAX_POOLS)
+        {
+            break;
+        }
+        pool_peak[i] = MAX(pool_peak[i], pool_used(pool));
+        i++;
+    }
+
+    i = 0;
+    STRUCT_SECTION_FOREACH(k_msgq, msgq)
+    {
+        if (i >= MAX_MSGQS)
+        {
+            break;
+        }
+        msgq_peak[i] = MAX(msgq_peak[i], msgq->used_msgs);
+        i++;
+    }
+
+    k_work_reschedule(&sample_work, K_MSEC(CONFIG_WATERING_MEM_DIAG_PERIOD_MS));
+}
+
+/* --- SNAPSHOT --- */
+
+struct snapshot
+{
+    uint8_t *buf;
+    size_t len;
+    uint8_t threads;
+    uint8_t flags;
+};
+
+static void put_name(struct snapshot *snap, const char *name)
+{
+    memset(&snap->buf[snap->len], 0, NAME_LEN);
+    if (name)
+    {
+        strncpy((char *)&snap->buf[snap->len], name, NAME_LEN);
+    }
+    snap->len += NAME_LEN;
+}
+
+static void put_thread(const struct k_thread *thread, void *user_data)
+{
+    struct snapshot *snap = user_data;
+    size_t unused = 0;
+
+    if (snap->threads >= MAX_THREADS)
+    {
+        snap->flags |= MEM_DIAG_FLAG_THREADS_TRUNCATED;
+        return;
+    }
+
+    k_thread_stack_space_get(thread, &unused);
+
+    put_name(snap, k_thread_name_get((k_tid_t)thread));
+    sys_put_le16(thread->stack_info.size, &snap->buf[snap->len]);
+    sys_put_le16(thread->stack_info.size - unused, &snap->buf[snap->len + 2]);
+    snap->len += 4;
+    snap->threads++;
+}
+
+// Serialize current usage into the characteristic layout
+static size_t build_snapshot(uint8_t *buf)
+{
+    struct snapshot snap = {.buf = buf, .len = MEM_DIAG_HDR_LEN, .flags = MEM_DIAG_FLAG_SAMPLED};
+    uint8_t pools = 0;
+    uint8_t msgqs = 0;
+    uint8_t heaps = 0;
+
+    k_thread_foreach_unlocked(put_thread, &snap);
+
+    STRUCT_SECTION_FOREACH(net_buf_pool, pool)
+    {
+        if (pools >= MAX_POOLS)
+        {
+            snap.flags |= MEM_DIAG_FLAG_POOLS_TRUNCATED;
+            break;
+        }
+        pool_peak[pools] = MAX(pool_peak[pools], pool_used(pool));
+        put_name(&snap, pool->name);
+        sys_put_le16(pool->buf_count, &buf[snap.len]);
+        sys_put_le16(pool_peak[pools], &buf[snap.len + 2]);
+        snap.len += 4;
+        pools++;
+    }
+
+    STRUCT_SECTION_FOREACH(k_msgq, msgq)
+    {
+        if (msgqs >= MAX_MSGQS)
+        {
+            snap.flags |= MEM_DIAG_FLAG_MSGQS_TRUNCATED;
+            break;
+        }
+        msgq_peak[msgqs] = MAX(msgq_peak[msgqs], msgq->used_msgs);
+        sys_put_le16(msgq->max_msgs, &buf[snap.len]);
+        sys_put_le16(msgq_peak[msgqs], &buf[snap.len + 2]);
+        snap.len += 4;
+        msgqs++;
+    }
+
+    STRUCT_SECTION_FOREACH(k_heap, heap)
+    {
+        struct sys_memory_stats stats;
+
+        if (heaps >= MAX_HEAPS)
+        {
+            snap.flags |= MEM_DIAG_FLAG_HEAPS_TRUNCATED;
+            break;
+        }
+        sys_heap_runtime_stats_get(&heap->heap, &stats);
+        sys_put_le32(stats.allocated_bytes + stats.free_bytes, &buf[snap.len]);
+        sys_put_le32(stats.max_allocated_bytes, &buf[snap.len + 4]);
+        snap.len += 8;
+        heaps++;
+    }
+
+    buf[0] = MEM_DIAG_VERSION;
+    buf[1] = snap.flags;
+    buf[2] = snap.threads;
+    buf[3] = pools;
+    buf[4] = msgqs;
+    buf[5] = heaps;
+    sys_put_le16(CONFIG_WATERING_MEM_DIAG_PERIOD_MS, &buf[6]);
+
+    return snap.len;
+}
+
+/* --- GATT SERVICE --- */
+
+static uint8_t snapshot_buf[MEM_DIAG_BUF_SIZE];
+static size_t snapshot_len;
+
+static ssize_t read_memory(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                           void *buf, uint16_t len, uint16_t offset)
+{
+    att_channels_mark_bulk();
+
+    // Keep the snapshot stable across the reads of a long read
+    if (offset == 0)
+    {
+        snapshot_len = build_snapshot(snapshot_buf);
+        LOG_INF("Read: Memory diagnostics (%zu bytes)", snapshot_len);
+    }
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, snapshot_buf, snapshot_len);
+}
+
+BT_GATT_SERVICE_DEFINE(diag_svc,
+                       BT_GATT_PRIMARY_SERVICE(BT_UUID_DIAG_SERVICE),
+
+                       // Thread names and buffer layout are only for authenticated peers
+                       BT_GATT_CHARACTERISTIC(BT_UUID_DIAG_MEMORY,
+                                              BT_GATT_CHRC_READ,
+                                              BT_GATT_PERM_READ_AUTHEN,
+                                              read_memory, NULL, NULL));
+
+/* --- SHELL COMMAND --- */
+
+#if defined(CONFIG_SHELL)
+static int cmd_mem(const struct shell *sh, size_t argc, char **argv)
+{
+    static uint8_t buf[MEM_DIAG_BUF_SIZE];
+    size_t pos = MEM_DIAG_HDR_LEN;
+
+    build_snapshot(buf);
+
+    shell_print(sh, "%-8s %8s %8s", "thread", "size", "peak");
+    for (int i = 0; i < buf[2]; i++, pos += 12)
+    {
+        shell_print(sh, "%-8.8s %8u %8u", (const char *)&buf[pos],
+                    sys_get_le16(&buf[pos + 8]), sys_get_le16(&buf[pos + 10]));
+    }
+
+    shell_print(sh, "%-8s %8s %8s", "pool", "bufs", "peak");
+    for (int i = 0; i < buf[3]; i++, pos += 12)
+    {
+        shell_print(sh, "%-8.8s %8u %8u", (const char *)&buf[pos],
+                    sys_get_le16(&buf[pos + 8]), sys_get_le16(&buf[pos + 10]));
+    }
+
+    for (int i = 0; i < buf[4]; i++, pos += 4)
+    {
+        shell_print(sh, "msgq %d: %u/%u peak", i, sys_get_le16(&buf[pos + 2]),
+                    sys_get_le16(&buf[pos]));
+    }
+
+    for (int i = 0; i < buf[5]; i++, pos += 8)
+    {
+        shell_print(sh, "heap %d: %u/%u bytes peak", i, sys_get_le32(&buf[pos + 4]),
+                    sys_get_le32(&buf[pos]));
+    }
+
+    shell_print(sh, "Pool and msgq peaks sampled every %u ms (lower bounds)",
+                CONFIG_WATERING_MEM_DIAG_PERIOD_MS);
+    if (buf[1] & (MEM_DIAG_FLAG_THREADS_TRUNCATED | MEM_DIAG_FLAG_POOLS_TRUNCATED |
+                  MEM_DIAG_FLAG_MSGQS_TRUNCATED | MEM_DIAG_FLAG_HEAPS_TRUNCATED))
+    {
+        shell_print(sh, "Truncated (flags 0x%02x) - raise the MAX_* limits in mem_diag.c", buf[1]);
+    }
+
+    return 0;
+}
+
+SHELL_CMD_REGISTER(mem, NULL, "Print stack, buffer pool and heap usage", cmd_mem);
+#endif
+
+/* --- INIT FUNCTION --- */
+
+int mem_diag_init(void)
+{
+    k_work_init_delayable(&sample_work, sample_peaks);
+    k_work_schedule(&sample_work, K_NO_WAIT);
+
+    LOG_INF("Memory diagnostics started");
+    return 0;
+}
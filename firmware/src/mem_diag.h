@@ -0,0 +1,26 @@
+#ifndef MEM_DIAG_H
+#define MEM_DIAG_H
+
+#if defined(CONFIG_WATERING_MEM_DIAG)
+
+/**
+ * @brief Initialize memory diagnostics
+ *
+ * Starts the periodic sampler that tracks peak usage of the network buffer
+ * pools and message queues. Thread stack and heap peaks are read on demand
+ * through the diagnostics characteristic or the "mem" shell command.
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int mem_diag_init(void);
+
+#else
+
+static inline int mem_diag_init(void)
+{
+    return 0;
+}
+
+#endif /* CONFIG_WATERING_MEM_DIAG */
+
+#endif /* MEM_DIAG_H */
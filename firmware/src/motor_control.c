@@ -1,7 +1,9 @@
 #include "motor_control.h"
+#include "pump_sense.h"
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/pwm.h>
 
 LOG_MODULE_REGISTER(motor_control, LOG_LEVEL_INF);
 
@@ -9,29 +11,132 @@ LOG_MODULE_REGISTER(motor_control, LOG_LEVEL_INF);
 #error "Overlay for motor output node not properly defined."
 #endif
 
+#if defined(CONFIG_WATERING_MOTOR_PWM)
+/* Soft-start ramp is split in this many duty steps */
+#define MOTOR_RAMP_STEPS 10
+
+static const struct pwm_dt_spec motor_pwm = PWM_DT_SPEC_GET(DT_NODELABEL(motor_switch));
+static const uint32_t soft_start_ms = DT_PROP(DT_NODELABEL(motor_switch), soft_start_ms);
+static struct k_work_delayable ramp_work;
+static uint8_t ramp_step;
+#else
 static const struct gpio_dt_spec motor_switch =
 	GPIO_DT_SPEC_GET_OR(DT_NODELABEL(motor_switch), gpios, {0});
+#endif
+
 static struct k_timer motor_timer;
+static struct k_work_delayable pulse_work;
+static struct k_spinlock lock; ///< Guards the run state and output writes
 static bool is_running = false;
+static motor_stopped_cb_t stopped_cb;
+
+/* Pulse train state */
+static uint32_t pulses_left;
+static uint32_t pulse_on_ms;
+static uint32_t pulse_off_ms;
+static uint8_t pulse_duty;
+
+/* Output on-time accounting for the current run */
+static bool output_on;
+static int64_t on_since_ms;
+static uint32_t on_time_ms;
+
+/* Internal helper function to drive the motor output (duty 0 = off, caller holds the lock) */
+static int motor_output_set(uint8_t duty_pct)
+{
+#if defined(CONFIG_WATERING_MOTOR_PWM)
+    int err = pwm_set_pulse_dt(&motor_pwm, (uint32_t)((uint64_t)motor_pwm.period * duty_pct / 100));
+#else
+    int err = gpio_pin_set_dt(&motor_switch, duty_pct > 0);
+#endif
+    if (err)
+    {
+        LOG_ERR("Failed to set motor output (err %d)", err);
+        return err;
+    }
 
-/* Internal helper function to control motor state */
-static int motor_set_state(bool enabled)
+    bool on = duty_pct > 0;
+    if (on && !output_on)
+    {
+        on_since_ms = k_uptime_get();
+    }
+    else if (!on && output_on)
+    {
+        on_time_ms += (uint32_t)(k_uptime_get() - on_since_ms);
+    }
+    output_on = on;
+    return 0;
+}
+
+#if defined(CONFIG_WATERING_MOTOR_PWM)
+/* Work handler raising the duty one step at a time */
+static void motor_ramp_step(struct k_work *work)
 {
-    if (is_running == enabled)
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (is_running && ramp_step < MOTOR_RAMP_STEPS)
     {
+        ramp_step++;
+        motor_output_set(100 * ramp_step / MOTOR_RAMP_STEPS);
+
+        if (ramp_step < MOTOR_RAMP_STEPS)
+        {
+            k_work_schedule(&ramp_work, K_MSEC(soft_start_ms / MOTOR_RAMP_STEPS));
+        }
+    }
+
+    k_spin_unlock(&lock, key);
+}
+#endif
+
+/* Switch the motor fully on, through the soft-start ramp when configured (caller holds the lock) */
+static int motor_output_ramp_up(void)
+{
+#if defined(CONFIG_WATERING_MOTOR_PWM)
+    if (soft_start_ms > 0)
+    {
+        ramp_step = 0;
+        k_work_schedule(&ramp_work, K_NO_WAIT);
         return 0;
     }
+#endif
+    return motor_output_set(100);
+}
 
-    int err = gpio_pin_set_dt(&motor_switch, enabled);
-    if (err)
+/* Work handler toggling the output for each pulse of a pulse train */
+static void motor_pulse_step(struct k_work *work)
+{
+    bool done = false;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (!is_running)
     {
-        LOG_ERR("Failed to set motor state (err %d)", err);
-        return err;
+        k_spin_unlock(&lock, key);
+        return;
     }
 
-    is_running = enabled;
-    LOG_INF("Motor %s", enabled ? "enabled" : "disabled");
-    return 0;
+    if (!output_on)
+    {
+        motor_output_set(pulse_duty);
+        k_work_schedule(&pulse_work, K_MSEC(pulse_on_ms));
+    }
+    else
+    {
+        motor_output_set(0);
+        done = --pulses_left == 0;
+        if (!done)
+        {
+            k_work_schedule(&pulse_work, K_MSEC(pulse_off_ms));
+        }
+    }
+
+    k_spin_unlock(&lock, key);
+
+    if (done)
+    {
+        LOG_INF("Pulse train complete");
+        motor_control_stop();
+    }
 }
 
 /* Timer callback for automatic motor stop */
@@ -45,6 +150,17 @@ int motor_control_init(void)
 {
     int err;
 
+#if defined(CONFIG_WATERING_MOTOR_PWM)
+    /* Check if PWM device is ready */
+    if (!pwm_is_ready_dt(&motor_pwm))
+    {
+        LOG_ERR("PWM device not ready");
+        return -ENODEV;
+    }
+
+    k_work_init_delayable(&ramp_work, motor_ramp_step);
+    LOG_INF("PWM motor output, soft start %u ms", soft_start_ms);
+#else
     /* Check if GPIO device is ready */
     if (!gpio_is_ready_dt(&motor_switch))
     {
@@ -52,9 +168,6 @@ int motor_control_init(void)
         return -ENODEV;
     }
 
-    /* Initialize motor timer */
-    k_timer_init(&motor_timer, motor_timeout, NULL);
-
     /* Configure motor GPIO */
     err = gpio_pin_configure_dt(&motor_switch, GPIO_OUTPUT | GPIO_ACTIVE_HIGH);
     if (err)
@@ -62,55 +175,142 @@ int motor_control_init(void)
         LOG_ERR("Failed to configure motor GPIO (err %d)", err);
         return err;
     }
+#endif
+
+    /* Initialize motor timer and pulse train work */
+    k_timer_init(&motor_timer, motor_timeout, NULL);
+    k_work_init_delayable(&pulse_work, motor_pulse_step);
+
+    /* Initialize optional current sensing */
+    err = pump_sense_init();
+    if (err)
+    {
+        LOG_ERR("Failed to initialize pump current sensing (err %d)", err);
+        return err;
+    }
 
     /* Ensure motor is off */
-    return motor_control_stop();
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    err = motor_output_set(0);
+    k_spin_unlock(&lock, key);
+    return err;
 }
 
 int motor_control_start(uint32_t duration_ms)
 {
     int err;
+    k_spinlock_key_t key = k_spin_lock(&lock);
 
     if (is_running)
     {
+        k_spin_unlock(&lock, key);
         LOG_WRN("Motor already running");
         return -EBUSY;
     }
 
-    LOG_INF("Starting motor for %u ms", duration_ms);
+#if defined(CONFIG_WATERING_MOTOR_PWM)
+    /* The linear ramp delivers about half the flow while it runs */
+    duration_ms += soft_start_ms / 2;
+#endif
 
     /* Start motor */
-    err = motor_set_state(true);
+    on_time_ms = 0;
+    is_running = true;
+    err = motor_output_ramp_up();
     if (err)
     {
+        is_running = false;
+        k_spin_unlock(&lock, key);
         return err;
     }
 
     /* Start timer for automatic stop */
     k_timer_start(&motor_timer, K_MSEC(duration_ms), K_NO_WAIT);
+
+    /* Under the lock, so a stop cannot land first and leave sensing armed */
+    pump_sense_start();
+    k_spin_unlock(&lock, key);
+
+    LOG_INF("Motor enabled for %u ms", duration_ms);
+    return 0;
+}
+
+int motor_control_start_pulses(uint32_t on_ms, uint32_t off_ms, uint32_t count, uint8_t duty_pct)
+{
+    if (count == 0 || on_ms == 0 || duty_pct == 0 || duty_pct > 100)
+    {
+        return -EINVAL;
+    }
+
+#if !defined(CONFIG_WATERING_MOTOR_PWM)
+    duty_pct = 100;
+#endif
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (is_running)
+    {
+        k_spin_unlock(&lock, key);
+        LOG_WRN("Motor already running");
+        return -EBUSY;
+    }
+
+    pulses_left = count;
+    pulse_on_ms = on_ms;
+    pulse_off_ms = off_ms;
+    pulse_duty = duty_pct;
+
+    /* Current sensing expects full duty, so it is not used for pulse trains */
+    on_time_ms = 0;
+    is_running = true;
+    k_work_schedule(&pulse_work, K_NO_WAIT);
+
+    k_spin_unlock(&lock, key);
+
+    LOG_INF("Starting %u pulses of %u ms at %u%% duty", count, on_ms, duty_pct);
     return 0;
 }
 
 int motor_control_stop(void)
 {
     int err;
+    k_spinlock_key_t key = k_spin_lock(&lock);
 
     if (!is_running)
     {
+        k_spin_unlock(&lock, key);
         return 0;
     }
 
-    /* Stop timer */
+    /* Stop timer and pending steps */
     k_timer_stop(&motor_timer);
+    k_work_cancel_delayable(&pulse_work);
+#if defined(CONFIG_WATERING_MOTOR_PWM)
+    k_work_cancel_delayable(&ramp_work);
+#endif
 
     /* Turn off motor */
-    err = motor_set_state(false);
+    err = motor_output_set(0);
     if (err)
     {
+        k_spin_unlock(&lock, key);
         LOG_ERR("Failed to stop motor (err %d)", err);
         return err;
     }
 
+    is_running = false;
+    uint32_t run_ms = on_time_ms;
+
+    k_spin_unlock(&lock, key);
+
+    pump_sense_stop();
+    LOG_INF("Motor disabled");
+
+    if (stopped_cb)
+    {
+        stopped_cb(run_ms);
+    }
+
     return 0;
 }
 
@@ -118,3 +318,13 @@ bool motor_control_is_running(void)
 {
     return is_running;
 }
+
+void motor_control_set_stopped_cb(motor_stopped_cb_t cb)
+{
+    stopped_cb = cb;
+}
+
+pump_fault_t motor_control_get_fault(void)
+{
+    return pump_sense_fault();
+}
@@ -3,12 +3,13 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "plant_common.h"
 
 /**
  * @brief Initialize motor control subsystem
  *
  * This function:
- * - Configures the motor GPIO pin
+ * - Configures the motor GPIO pin, or the PWM channel for a "pwm-pump" node
  * - Initializes the motor timer
  * - Sets the motor to OFF state
  *
@@ -19,11 +20,28 @@ int motor_control_init(void);
 /**
  * @brief Start the motor for a specified duration
  *
+ * With a PWM output the motor is brought up through the soft-start ramp,
+ * and the run is extended to make up for the reduced flow during the ramp.
+ *
  * @param duration_ms Duration to run the motor in milliseconds
  * @return 0 on success, negative error code on failure
  */
 int motor_control_start(uint32_t duration_ms);
 
+/**
+ * @brief Deliver a train of short motor pulses
+ *
+ * Used for accurate small doses: every pulse is a fixed, calibrated on-time.
+ * The motor counts as running until the last pulse has completed.
+ *
+ * @param on_ms    On-time of each pulse in milliseconds
+ * @param off_ms   Pause between pulses in milliseconds
+ * @param count    Number of pulses
+ * @param duty_pct PWM duty during a pulse (1-100); always 100 with a GPIO switch
+ * @return 0 on success, negative error code on failure
+ */
+int motor_control_start_pulses(uint32_t on_ms, uint32_t off_ms, uint32_t count, uint8_t duty_pct);
+
 /**
  * @brief Immediately stop the motor
  *
@@ -38,4 +56,29 @@ int motor_control_stop(void);
  */
 bool motor_control_is_running(void);
 
+/**
+ * @brief Get the fault that stopped the last motor run
+ *
+ * Always PUMP_FAULT_NONE when pump current sensing is not enabled.
+ *
+ * @return Fault condition of the last run
+ */
+pump_fault_t motor_control_get_fault(void);
+
+/**
+ * @brief Callback invoked each time the motor stops
+ *
+ * May be called from the motor timer (interrupt) context.
+ *
+ * @param run_ms Time the motor output was on in milliseconds
+ */
+typedef void (*motor_stopped_cb_t)(uint32_t run_ms);
+
+/**
+ * @brief Register a callback for motor stop events
+ *
+ * @param cb Callback to invoke, or NULL to remove it
+ */
+void motor_control_set_stopped_cb(motor_stopped_cb_t cb);
+
 #endif /* MOTOR_CONTROL_H */
\ No newline at end of file
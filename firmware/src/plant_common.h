@@ -18,6 +18,22 @@ typedef enum
     PLANT_MODE_SCHEDULED = 2,
 } plant_mode_t;
 
+/**
+ * @brief Pump fault conditions
+ *
+ * NONE: Pump current within the expected window (or not sensed)
+ * DRY_RUN: Current too low, reservoir likely empty
+ * STALLED: Current too high, pump blocked
+ * DISCONNECTED: No current, pump not connected
+ */
+typedef enum
+{
+    PUMP_FAULT_NONE = 0,
+    PUMP_FAULT_DRY_RUN = 1,
+    PUMP_FAULT_STALLED = 2,
+    PUMP_FAULT_DISCONNECTED = 3,
+} pump_fault_t;
+
 /**
  * @brief Plant watering configuration
  */
@@ -37,6 +53,7 @@ struct plant_status
     uint32_t last_watered_seconds;  ///< Time since last watering in seconds
     uint32_t next_watering_seconds; ///< Time until next scheduled watering in seconds
     bool watering;                  ///< Whether watering is currently in progress
+    pump_fault_t fault;             ///< Fault that stopped the last watering
 };
 
 #endif /* PLANT_COMMON_H */
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "plant_manager.h"
 #include "motor_control.h"
 #include "bluetooth.h"
+#include "dfu.h"
+#include "energy.h"
+#include "watering_stats.h"
+#include "schedule.h"
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/bluetooth/gatt.h>
@@ -12,6 +16,14 @@ static struct plant_status *stat;
 
 static struct k_work_delayable plant_work;
 
+/* Planned volume and duration of the current watering, for stats */
+static uint32_t planned_ml;
+static uint32_t planned_ms;
+
+static plant_mode_t last_mode = PLANT_MODE_OFF;
+static uint16_t last_interval = 0;
+static uint16_t last_amount = 0;
+
 // Notify BLE clients about watering status change
 static void notify_watering_status(void)
 {
@@ -20,6 +32,14 @@ static void notify_watering_status(void)
     notify_clients(&watering_svc.attrs[WATERING_STATUS_ATTR_POS], &status, sizeof(status));
 }
 
+// Notify BLE clients about pump fault change
+static void notify_pump_fault(void)
+{
+    uint8_t fault = (uint8_t)stat->fault;
+    LOG_INF("Notifying pump fault: %u", fault);
+    notify_clients(&watering_svc.attrs[PUMP_FAULT_ATTR_POS], &fault, sizeof(fault));
+}
+
 // Notify BLE clients about last watered time
 static void notify_last_watered(void)
 {
@@ -32,13 +52,43 @@ static void notify_last_watered(void)
 // Notify BLE clients about next watering time
 static void notify_next_watering(void)
 {
-    uint32_t now = k_uptime_get_32() / 1000; // Convert to seconds
-    uint32_t next_seconds = stat->next_watering_seconds;
-    uint32_t time_until = next_seconds > now ? next_seconds - now : 0;
+    uint32_t time_until = schedule_time_until();
     LOG_INF("Notifying next watering: %u seconds from now", time_until);
     notify_clients(&watering_svc.attrs[NEXT_WATERING_ATTR_POS], &time_until, sizeof(time_until));
 }
 
+// Notify BLE clients about the planned waterings
+static void notify_schedule(void)
+{
+    uint8_t horizon[SCHEDULE_SERIALIZED_SIZE];
+    size_t len = schedule_serialize(horizon, MIN(sizeof(horizon), bluetooth_notify_max_len()));
+
+    if (len > 0)
+    {
+        LOG_INF("Notifying schedule: %u waterings", horizon[1]);
+        notify_clients(&watering_svc.attrs[SCHEDULE_ATTR_POS], horizon, len);
+    }
+}
+
+// Publish a changed schedule horizon and arm the work item for its next watering
+static void schedule_changed(void)
+{
+    uint32_t next_at;
+
+    if (schedule_next(&next_at))
+    {
+        stat->next_watering_seconds = next_at;
+        k_work_reschedule(&plant_work, K_SECONDS(schedule_time_until()));
+    }
+    else
+    {
+        k_work_cancel_delayable(&plant_work);
+    }
+
+    notify_next_watering();
+    notify_schedule();
+}
+
 /**
  * Compute the pump-on time (in milliseconds) for a given volume (in mL).
  * Piecewise flow rate:
@@ -59,20 +109,69 @@ static uint32_t pump_time_ms(uint32_t volume_ml)
     return (volume_ml * 1000) / rate; // Convert to milliseconds
 }
 
+/**
+ * Compute the total pump-on time (in milliseconds) for a small dose (in mL)
+ * delivered as pulses at the calibrated dosing flow rate.
+ *
+ * @param volume_ml  Desired volume in milliliters.
+ * @return           Time in milliseconds
+ */
+static uint32_t dose_time_ms(uint32_t volume_ml)
+{
+    return (volume_ml * 1000) / CONFIG_WATERING_DOSE_FLOW_ML_PER_S;
+}
+
 // Watering task
 static void perform_watering(struct k_work *work)
 {
+    // A scheduled watering moves the horizon on, even if it is skipped below
+    if (work && cfg->mode == PLANT_MODE_SCHEDULED)
+    {
+        schedule_advance(cfg);
+        LOG_INF("Next watering in %u seconds", schedule_time_until());
+        schedule_changed();
+    }
+
     if (motor_control_is_running())
     {
         LOG_WRN("Watering already in progress");
         return;
     }
 
+    if (dfu_in_progress())
+    {
+        LOG_WRN("Firmware update in progress - watering skipped");
+        return;
+    }
+
+    if (!energy_watering_allowed())
+    {
+        LOG_WRN("Battery below cutoff - watering skipped");
+        return;
+    }
+
     LOG_INF("Starting watering cycle: %u ml", cfg->amount_ml);
 
-    // Calculate watering duration (25ml per second)
-    uint32_t duration_ms = pump_time_ms(cfg->amount_ml);
-    int err = motor_control_start(duration_ms);
+    int err;
+    planned_ml = cfg->amount_ml;
+
+    if (cfg->amount_ml > 0 && cfg->amount_ml < CONFIG_WATERING_DOSE_THRESHOLD_ML)
+    {
+        // Small volumes as a train of calibrated pulses
+        uint32_t pulses = DIV_ROUND_UP(cfg->amount_ml, CONFIG_WATERING_DOSE_PULSE_ML);
+        uint32_t pulse_ms = dose_time_ms(cfg->amount_ml) / pulses;
+        planned_ms = pulse_ms * pulses;
+        err = motor_control_start_pulses(pulse_ms, CONFIG_WATERING_DOSE_PAUSE_MS, pulses,
+                                         CONFIG_WATERING_DOSE_DUTY_PCT);
+    }
+    else
+    {
+        // Calculate watering duration (25ml per second)
+        uint32_t duration_ms = pump_time_ms(cfg->amount_ml);
+        planned_ms = duration_ms;
+        err = motor_control_start(duration_ms);
+    }
+
     if (err)
     {
         LOG_ERR("Failed to start watering (err %d)", err);
@@ -84,16 +183,13 @@ static void perform_watering(struct k_work *work)
     stat->watering = true;
     notify_watering_status();
     notify_last_watered();
+}
 
-    // Schedule next watering if in scheduled mode
-    if (cfg->mode == PLANT_MODE_SCHEDULED)
-    {
-        uint32_t now = k_uptime_get_32() / 1000;
-        stat->next_watering_seconds = now + (cfg->interval_min * 60);
-        LOG_INF("Next watering scheduled in %u minutes", cfg->interval_min);
-        k_work_reschedule(&plant_work, K_MINUTES(cfg->interval_min));
-        notify_next_watering();
-    }
+// Record the delivered volume when the pump stops (also on an early stop)
+static void watering_stopped(uint32_t run_ms)
+{
+    uint32_t delivered_ml = run_ms >= planned_ms ? planned_ml : (uint32_t)((uint64_t)planned_ml * run_ms / planned_ms);
+    watering_stats_record(delivered_ml, run_ms);
 }
 
 // Initialization function
@@ -112,6 +208,7 @@ int plant_manager_init(struct plant_config *config, struct plant_status *status)
     }
 
     k_work_init_delayable(&plant_work, perform_watering);
+    motor_control_set_stopped_cb(watering_stopped);
 
     // Initialize with OFF mode
     cfg->mode = PLANT_MODE_OFF;
@@ -119,15 +216,35 @@ int plant_manager_init(struct plant_config *config, struct plant_status *status)
     return 0;
 }
 
+// Resume the schedule from restored state
+void plant_manager_restore(uint32_t next_in_seconds)
+{
+    last_mode = cfg->mode;
+    last_interval = cfg->interval_min;
+    last_amount = cfg->amount_ml;
+
+    // The uptime base restarted, so the horizon is re-anchored
+    if (cfg->mode == PLANT_MODE_SCHEDULED)
+    {
+        LOG_INF("Schedule restored: next watering in %u seconds", next_in_seconds);
+    }
+    schedule_rebuild(cfg, next_in_seconds);
+    schedule_changed();
+}
+
 // Periodic tick function
 void plant_manager_tick(void)
 {
-    static plant_mode_t last_mode = PLANT_MODE_OFF;
     static bool was_watering = false;
-    static uint16_t last_interval = 0;
+    static uint8_t notify_ticks = 0;
 
-    notify_last_watered();
-    notify_next_watering();
+    // Periodic notifications are stretched as the battery drains
+    if (++notify_ticks >= energy_notify_divisor())
+    {
+        notify_ticks = 0;
+        notify_last_watered();
+        notify_next_watering();
+    }
 
     // Update watering status based on motor state
     bool is_watering = motor_control_is_running();
@@ -139,6 +256,15 @@ void plant_manager_tick(void)
         notify_watering_status();
     }
 
+    // Report pump faults detected by current sensing
+    pump_fault_t fault = motor_control_get_fault();
+    if (fault != stat->fault)
+    {
+        LOG_INF("Pump fault changed: %d -> %d", stat->fault, fault);
+        stat->fault = fault;
+        notify_pump_fault();
+    }
+
     // Handle mode transition
     if (cfg->mode != last_mode)
     {
@@ -153,18 +279,17 @@ void plant_manager_tick(void)
             motor_control_stop();
         }
 
-        // Schedule next watering if in scheduled mode
+        // Plan waterings if in scheduled mode
         if (cfg->mode == PLANT_MODE_SCHEDULED)
         {
-            uint32_t now = k_uptime_get_32() / 1000;
-            stat->next_watering_seconds = now + (cfg->interval_min * 60);
             LOG_INF("Scheduling watering in %u minutes", cfg->interval_min);
-            k_work_schedule(&plant_work, K_MINUTES(cfg->interval_min));
-            notify_next_watering();
         }
+        schedule_rebuild(cfg, cfg->interval_min * 60);
+        schedule_changed();
 
         last_mode = cfg->mode;
         last_interval = cfg->interval_min;
+        last_amount = cfg->amount_ml;
     }
 
     // Handle interval change in scheduled mode
@@ -172,16 +297,23 @@ void plant_manager_tick(void)
     {
         LOG_INF("Interval changed from %u to %u minutes", last_interval, cfg->interval_min);
 
-        // Cancel current schedule
-        k_work_cancel_delayable(&plant_work);
-
-        // Reschedule with new interval
-        uint32_t now = k_uptime_get_32() / 1000;
-        stat->next_watering_seconds = now + (cfg->interval_min * 60);
-        k_work_schedule(&plant_work, K_MINUTES(cfg->interval_min));
-        notify_next_watering();
+        // Replan with new interval
+        schedule_rebuild(cfg, cfg->interval_min * 60);
+        schedule_changed();
 
         last_interval = cfg->interval_min;
+        last_amount = cfg->amount_ml;
+    }
+
+    // Handle amount change in scheduled mode (times are kept)
+    if (cfg->mode == PLANT_MODE_SCHEDULED && cfg->amount_ml != last_amount)
+    {
+        LOG_INF("Amount changed from %u to %u ml", last_amount, cfg->amount_ml);
+
+        schedule_rebuild(cfg, schedule_time_until());
+        notify_schedule();
+
+        last_amount = cfg->amount_ml;
     }
 
     // Handle manual watering trigger
@@ -22,4 +22,14 @@ int plant_manager_init(struct plant_config *config, struct plant_status *status)
  */
 void plant_manager_tick(void);
 
+/**
+ * @brief Continue a schedule that was running before a reboot
+ *
+ * Takes the restored configuration as the current state (no mode transition
+ * is seen by the next tick) and, in scheduled mode, arms the next watering.
+ *
+ * @param next_in_seconds Time left until the next watering in seconds
+ */
+void plant_manager_restore(uint32_t next_in_seconds);
+
 #endif /* PLANT_MANAGER_H */
@@ -0,0 +1,224 @@
+#include "pump_sense.h"
+#include "motor_control.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/current_sense_shunt.h>
+
+LOG_MODULE_REGISTER(pump_sense, LOG_LEVEL_INF);
+
+#define BATCH_SIZE CONFIG_WATERING_PUMP_SENSE_BATCH
+#define BATCH_TIMEOUT K_USEC(2 * BATCH_SIZE * CONFIG_WATERING_PUMP_SENSE_INTERVAL_US + 10000)
+
+static const struct current_sense_shunt_dt_spec shunt =
+    CURRENT_SENSE_SHUNT_DT_SPEC_GET(DT_NODELABEL(motor_current));
+
+static int16_t samples[BATCH_SIZE];
+static struct k_poll_signal batch_done = K_POLL_SIGNAL_INITIALIZER(batch_done);
+
+static K_SEM_DEFINE(start_sem, 0, 1);
+static atomic_t active;
+static atomic_t generation; ///< Bumped by every start, ends a stale monitoring loop
+static atomic_t fault = ATOMIC_INIT(PUMP_FAULT_NONE);
+
+/* Integer square root of a 64-bit value */
+static uint32_t isqrt64(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)root;
+}
+
+/* RMS current of the last batch in mA */
+static int32_t batch_rms_ma(void)
+{
+    uint64_t sum_sq = 0;
+
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        int32_t raw = MAX(samples[i], 0);
+        sum_sq += (uint64_t)(raw * raw);
+    }
+
+    int32_t value = (int32_t)isqrt64(sum_sq / BATCH_SIZE);
+    adc_raw_to_millivolts_dt(&shunt.port, &value);
+    current_sense_shunt_scale_dt(&shunt, &value);
+    return value;
+}
+
+static pump_fault_t classify(int32_t rms_ma)
+{
+    if (rms_ma < CONFIG_WATERING_PUMP_CURRENT_OPEN_MA)
+    {
+        return PUMP_FAULT_DISCONNECTED;
+    }
+    if (rms_ma < CONFIG_WATERING_PUMP_CURRENT_MIN_MA)
+    {
+        return PUMP_FAULT_DRY_RUN;
+    }
+    if (rms_ma > CONFIG_WATERING_PUMP_CURRENT_MAX_MA)
+    {
+        return PUMP_FAULT_STALLED;
+    }
+    return PUMP_FAULT_NONE;
+}
+
+// Take one batch. The driver times the samplings in software (a kernel timer
+// per interval, one conversion interrupt per sample), so spacing jitters with
+// interrupt latency; this thread only wakes once the batch is complete
+static int sample_batch(void)
+{
+    struct adc_sequence_options options = {
+        .interval_us = CONFIG_WATERING_PUMP_SENSE_INTERVAL_US,
+        .extra_samplings = BATCH_SIZE - 1,
+    };
+    struct adc_sequence sequence = {
+        .options = &options,
+        .buffer = samples,
+        .buffer_size = sizeof(samples),
+    };
+    struct k_poll_event event = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL,
+                                                         K_POLL_MODE_NOTIFY_ONLY,
+                                                         &batch_done);
+    int err;
+
+    adc_sequence_init_dt(&shunt.port, &sequence);
+    k_poll_signal_reset(&batch_done);
+
+    err = adc_read_async(shunt.port.dev, &sequence, &batch_done);
+    if (err)
+    {
+        return err;
+    }
+
+    err = k_poll(&event, 1, BATCH_TIMEOUT);
+    if (err)
+    {
+        return err;
+    }
+
+    int result;
+    unsigned int signaled;
+    k_poll_signal_check(&batch_done, &signaled, &result);
+    return result;
+}
+
+// Monitor one pump run until it stops, is restarted or a fault is detected
+static void monitor_run(void)
+{
+    atomic_val_t run = atomic_get(&generation);
+    int64_t settle_until = k_uptime_get() + CONFIG_WATERING_PUMP_SENSE_SETTLE_MS;
+    int32_t peak_q4 = 0;
+    int32_t avg_q4 = 0;
+    int32_t rms_ma = 0;
+    int bad_batches = 0;
+
+    while (atomic_get(&active) && atomic_get(&generation) == run)
+    {
+        int err = sample_batch();
+        if (err)
+        {
+            LOG_ERR("ADC batch failed (err %d)", err);
+            break;
+        }
+
+        if (!atomic_get(&active) || atomic_get(&generation) != run ||
+            k_uptime_get() < settle_until)
+        {
+            continue;
+        }
+
+        // Exponential average in Q4 fixed point and its fall from the peak of this run
+        rms_ma = batch_rms_ma();
+        avg_q4 = avg_q4 == 0 ? rms_ma << 4 : avg_q4 + ((rms_ma << 4) - avg_q4) / 4;
+        peak_q4 = MAX(peak_q4, avg_q4);
+        int32_t drop_pct = peak_q4 > 0 ? 100 - (avg_q4 * 100) / peak_q4 : 0;
+        LOG_DBG("Pump current %d mA (avg %d, %d%% below peak)", rms_ma, avg_q4 >> 4, drop_pct);
+
+        // A pump losing its prime draws less current long before it reaches the dry floor
+        pump_fault_t detected = classify(rms_ma);
+        if (detected == PUMP_FAULT_NONE && CONFIG_WATERING_PUMP_CURRENT_DROP_PCT > 0 &&
+            drop_pct >= CONFIG_WATERING_PUMP_CURRENT_DROP_PCT)
+        {
+            detected = PUMP_FAULT_DRY_RUN;
+        }
+        bad_batches = detected == PUMP_FAULT_NONE ? 0 : bad_batches + 1;
+
+        if (bad_batches >= CONFIG_WATERING_PUMP_FAULT_BATCHES)
+        {
+            LOG_WRN("Pump fault %d at %d mA - stopping", detected, rms_ma);
+            atomic_set(&fault, detected);
+            motor_control_stop();
+            break;
+        }
+    }
+
+    LOG_INF("Pump current: last %d mA, avg %d mA", rms_ma, avg_q4 >> 4);
+}
+
+static void pump_sense_thread(void *p1, void *p2, void *p3)
+{
+    while (1)
+    {
+        k_sem_take(&start_sem, K_FOREVER);
+        monitor_run();
+    }
+}
+
+K_THREAD_DEFINE(pump_sense_tid, 1024, pump_sense_thread, NULL, NULL, NULL, 7, 0, 0);
+
+int pump_sense_init(void)
+{
+    if (!adc_is_ready_dt(&shunt.port))
+    {
+        LOG_ERR("ADC device not ready");
+        return -ENODEV;
+    }
+
+    int err = adc_channel_setup_dt(&shunt.port);
+    if (err)
+    {
+        LOG_ERR("Failed to set up ADC channel (err %d)", err);
+        return err;
+    }
+
+    return 0;
+}
+
+void pump_sense_start(void)
+{
+    atomic_set(&fault, PUMP_FAULT_NONE);
+    atomic_inc(&generation);
+    atomic_set(&active, 1);
+    k_sem_give(&start_sem);
+}
+
+void pump_sense_stop(void)
+{
+    atomic_set(&active, 0);
+}
+
+pump_fault_t pump_sense_fault(void)
+{
+    return (pump_fault_t)atomic_get(&fault);
+}
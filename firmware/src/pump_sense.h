@@ -0,0 +1,61 @@
+#ifndef PUMP_SENSE_H
+#define PUMP_SENSE_H
+
+#include "plant_common.h"
+
+#if defined(CONFIG_WATERING_PUMP_CURRENT_SENSE)
+
+/**
+ * @brief Initialize pump current sensing
+ *
+ * Configures the shunt ADC channel from the motor_current node.
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int pump_sense_init(void);
+
+/**
+ * @brief Start sampling the pump current
+ *
+ * Clears any previous fault. Call right after the motor is switched on;
+ * safe from ISRs and with a spinlock held.
+ */
+void pump_sense_start(void);
+
+/**
+ * @brief Stop sampling the pump current
+ *
+ * Safe to call from interrupt context.
+ */
+void pump_sense_stop(void);
+
+/**
+ * @brief Get the fault detected during the last run
+ *
+ * @return Fault condition, PUMP_FAULT_NONE if the current stayed in range
+ */
+pump_fault_t pump_sense_fault(void);
+
+#else
+
+static inline int pump_sense_init(void)
+{
+    return 0;
+}
+
+static inline void pump_sense_start(void)
+{
+}
+
+static inline void pump_sense_stop(void)
+{
+}
+
+static inline pump_fault_t pump_sense_fault(void)
+{
+    return PUMP_FAULT_NONE;
+}
+
+#endif /* CONFIG_WATERING_PUMP_CURRENT_SENSE */
+
+#endif /* PUMP_SENSE_H */
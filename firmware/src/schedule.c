@@ -0,0 +1,168 @@
+#include "schedule.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+LOG_MODULE_REGISTER(schedule, LOG_LEVEL_INF);
+
+#define HORIZON_SECONDS (CONFIG_WATERING_SCHEDULE_HORIZON_DAYS * 24 * 3600)
+
+/**
+ * @brief Planned watering
+ */
+struct planned_watering
+{
+    uint32_t at_seconds; ///< Uptime of the watering
+    uint16_t amount_ml;  ///< Planned volume
+};
+
+/* Ring of planned waterings, soonest at head */
+static struct planned_watering horizon[CONFIG_WATERING_SCHEDULE_HORIZON];
+static size_t head;
+static size_t count;
+static uint32_t interval_seconds;
+static uint16_t amount_ml;
+static struct k_spinlock lock;
+
+// Seconds since boot from the 64-bit uptime; the 32-bit millisecond uptime would
+// wrap after 49.7 days and strand every planned watering in the future
+static uint32_t now_seconds(void)
+{
+    return (uint32_t)(k_uptime_get() / MSEC_PER_SEC);
+}
+
+static const struct planned_watering *entry(size_t i)
+{
+    return &horizon[(head + i) % ARRAY_SIZE(horizon)];
+}
+
+static void push(uint32_t at_seconds)
+{
+    struct planned_watering *slot = &horizon[(head + count) % ARRAY_SIZE(horizon)];
+
+    slot->at_seconds = at_seconds;
+    slot->amount_ml = amount_ml;
+    count++;
+}
+
+// Append waterings until the ring is full or the horizon is covered
+static void fill(uint32_t now)
+{
+    while (count < ARRAY_SIZE(horizon))
+    {
+        uint32_t at = entry(count - 1)->at_seconds + interval_seconds;
+
+        if (interval_seconds == 0 || at - now > HORIZON_SECONDS)
+        {
+            break;
+        }
+        push(at);
+    }
+}
+
+void schedule_rebuild(const struct plant_config *config, uint32_t first_in_secs)
+{
+    uint32_t now = now_seconds();
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    head = 0;
+    count = 0;
+    interval_seconds = config->interval_min * 60;
+    amount_ml = config->amount_ml;
+
+    // Without an interval there is nothing to plan
+    if (config->mode == PLANT_MODE_SCHEDULED && interval_seconds > 0)
+    {
+        push(now + first_in_secs);
+        fill(now);
+    }
+
+    size_t planned = count;
+    k_spin_unlock(&lock, key);
+
+    LOG_INF("Schedule rebuilt: %zu waterings planned", planned);
+}
+
+void schedule_advance(const struct plant_config *config)
+{
+    uint32_t now = now_seconds();
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    // Drop every watering that is due, including any that were missed
+    while (count > 0 && (int32_t)(entry(0)->at_seconds - now) <= 0)
+    {
+        head = (head + 1) % ARRAY_SIZE(horizon);
+        count--;
+    }
+
+    bool empty = count == 0;
+    if (!empty)
+    {
+        fill(now);
+    }
+
+    k_spin_unlock(&lock, key);
+
+    if (empty)
+    {
+        schedule_rebuild(config, config->interval_min * 60);
+    }
+}
+
+uint32_t schedule_time_until(void)
+{
+    uint32_t at;
+
+    if (!schedule_next(&at))
+    {
+        return 0;
+    }
+
+    int32_t until = (int32_t)(at - now_seconds());
+    return until > 0 ? until : 0;
+}
+
+bool schedule_next(uint32_t *at_seconds)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    bool planned = count > 0;
+    if (planned)
+    {
+        *at_seconds = entry(0)->at_seconds;
+    }
+
+    k_spin_unlock(&lock, key);
+    return planned;
+}
+
+size_t schedule_serialize(uint8_t *buf, size_t max_len)
+{
+    uint32_t now = now_seconds();
+    uint8_t *p = &buf[SCHEDULE_HEADER_LEN];
+    uint8_t n = 0;
+
+    if (max_len < SCHEDULE_HEADER_LEN)
+    {
+        return 0;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    size_t fits = MIN(count, (max_len - SCHEDULE_HEADER_LEN) / SCHEDULE_ENTRY_LEN);
+    for (; n < fits; n++)
+    {
+        const struct planned_watering *w = entry(n);
+        int32_t until = (int32_t)(w->at_seconds - now);
+
+        sys_put_le32(until > 0 ? until : 0, p);
+        sys_put_le16(w->amount_ml, p + 4);
+        p += SCHEDULE_ENTRY_LEN;
+    }
+
+    k_spin_unlock(&lock, key);
+
+    buf[0] = SCHEDULE_VERSION;
+    buf[1] = n;
+    return p - buf;
+}
@@ -0,0 +1,60 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "plant_common.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Serialized horizon: version, count, then per watering the time until it
+ * (uint32, seconds) and the planned amount (uint16, mL), soonest first.
+ */
+#define SCHEDULE_VERSION 1
+#define SCHEDULE_HEADER_LEN 2
+#define SCHEDULE_ENTRY_LEN 6
+#define SCHEDULE_SERIALIZED_SIZE (SCHEDULE_HEADER_LEN + CONFIG_WATERING_SCHEDULE_HORIZON * SCHEDULE_ENTRY_LEN)
+
+/**
+ * @brief Rebuild the schedule horizon from the configuration
+ *
+ * Call on configuration changes and when the time base is re-anchored.
+ * Outside scheduled mode, or with a zero interval, the horizon is empty.
+ *
+ * @param config        Pointer to plant configuration
+ * @param first_in_secs Time until the first planned watering in seconds
+ */
+void schedule_rebuild(const struct plant_config *config, uint32_t first_in_secs);
+
+/**
+ * @brief Consume the planned waterings that are due and extend the horizon
+ *
+ * Call when the scheduled watering fires, whether or not it ran.
+ *
+ * @param config Pointer to plant configuration
+ */
+void schedule_advance(const struct plant_config *config);
+
+/**
+ * @brief Get the time until the next planned watering
+ *
+ * @return Seconds until the next watering, 0 if due or none planned
+ */
+uint32_t schedule_time_until(void);
+
+/**
+ * @brief Get the uptime of the next planned watering
+ *
+ * @param at_seconds Set to the uptime in seconds of the next watering
+ * @return true if a watering is planned, false otherwise
+ */
+bool schedule_next(uint32_t *at_seconds);
+
+/**
+ * @brief Serialize the horizon for BLE
+ *
+ * @param buf     Output buffer
+ * @param max_len Size of the output buffer, the horizon is truncated to fit
+ * @return Number of bytes written
+ */
+size_t schedule_serialize(uint8_t *buf, size_t max_len);
+
+#endif /* SCHEDULE_H */
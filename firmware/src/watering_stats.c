@@ -0,0 +1,278 @@
+#include "watering_stats.h"
+#include "energy.h"
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/settings/settings.h>
+
+LOG_MODULE_REGISTER(watering_stats, LOG_LEVEL_INF);
+
+#define STATS_VERSION 1
+#define HOURS_PER_DAY 24
+#define HOURS_PER_WEEK (24 * 7)
+#define HOURS_TRACKED (HOURS_PER_WEEK * WATERING_STATS_WEEKS)
+
+/* Coalesce flash writes: save at most once per this delay after a watering */
+#define STATS_SAVE_DELAY K_MINUTES(10)
+
+/* On a low battery a save is postponed by an hour, but at most this many times */
+#define STATS_SAVE_MAX_DEFERRALS 6
+
+struct stats_bucket
+{
+    uint32_t volume_ml;
+    uint32_t pump_ms;
+    uint16_t count;
+};
+
+/* Rollup store, persisted as a single settings entry.
+ * hourly holds the current and past hours, daily the completed hours of
+ * each day and weekly the completed days of each week.
+ */
+struct stats_store
+{
+    uint32_t hour; ///< Absolute hour index of the current hourly bucket
+    struct stats_bucket hourly[WATERING_STATS_HOURS];
+    struct stats_bucket daily[WATERING_STATS_DAYS];
+    struct stats_bucket weekly[WATERING_STATS_WEEKS];
+};
+
+static struct stats_store store;
+static uint32_t hour_offset; ///< Hour index at uptime zero (restored from flash)
+static struct k_spinlock lock;
+
+static void save_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(save_work, save_work_handler);
+
+static struct stats_bucket *hour_bucket(uint32_t hour)
+{
+    return &store.hourly[hour % WATERING_STATS_HOURS];
+}
+
+static struct stats_bucket *day_bucket(uint32_t hour)
+{
+    return &store.daily[(hour / HOURS_PER_DAY) % WATERING_STATS_DAYS];
+}
+
+static struct stats_bucket *week_bucket(uint32_t hour)
+{
+    return &store.weekly[(hour / HOURS_PER_WEEK) % WATERING_STATS_WEEKS];
+}
+
+/* Buckets before the first tracked hour are empty */
+static const struct stats_bucket empty_bucket;
+
+static const struct stats_bucket *hours_ago(struct stats_bucket *(*bucket)(uint32_t), uint32_t hours)
+{
+    return store.hour >= hours ? bucket(store.hour - hours) : &empty_bucket;
+}
+
+static void bucket_add(struct stats_bucket *dst, const struct stats_bucket *src)
+{
+    dst->volume_ml += src->volume_ml;
+    dst->pump_ms += src->pump_ms;
+    dst->count += src->count;
+}
+
+static uint32_t current_hour(void)
+{
+    return hour_offset + (uint32_t)(k_uptime_get() / (MSEC_PER_SEC * 3600));
+}
+
+// Close the current hour and open the next one, folding into coarser buckets
+static void roll_one_hour(void)
+{
+    uint32_t closing = store.hour;
+    uint32_t opening = closing + 1;
+
+    bucket_add(day_bucket(closing), hour_bucket(closing));
+
+    if (opening % HOURS_PER_DAY == 0)
+    {
+        bucket_add(week_bucket(closing), day_bucket(closing));
+        if (opening % HOURS_PER_WEEK == 0)
+        {
+            memset(week_bucket(opening), 0, sizeof(struct stats_bucket));
+        }
+        memset(day_bucket(opening), 0, sizeof(struct stats_bucket));
+    }
+
+    memset(hour_bucket(opening), 0, sizeof(struct stats_bucket));
+    store.hour = opening;
+}
+
+// Skip a whole day without waterings; store.hour is the first hour of that day
+static void roll_one_day(void)
+{
+    uint32_t closing = store.hour;
+    uint32_t opening = closing + HOURS_PER_DAY;
+
+    bucket_add(day_bucket(closing), hour_bucket(closing));
+    bucket_add(week_bucket(closing), day_bucket(closing));
+    if (opening % HOURS_PER_WEEK == 0)
+    {
+        memset(week_bucket(opening), 0, sizeof(struct stats_bucket));
+    }
+    memset(day_bucket(opening), 0, sizeof(struct stats_bucket));
+
+    // Every hourly bucket now belongs to the skipped day
+    memset(store.hourly, 0, sizeof(store.hourly));
+    store.hour = opening;
+}
+
+// Bring the store up to the current hour (caller holds the lock). Bounded by
+// the hours left in the open day, the whole days skipped and the hours of the
+// current day, so it stays short even after a long idle period.
+static void advance(void)
+{
+    uint32_t now = current_hour();
+
+    if (now - store.hour > HOURS_TRACKED)
+    {
+        // Everything kept is older than the oldest bucket
+        memset(&store, 0, sizeof(store));
+        store.hour = now;
+        return;
+    }
+
+    // Close the open day hour by hour
+    while (store.hour != now && store.hour % HOURS_PER_DAY != 0)
+    {
+        roll_one_hour();
+    }
+
+    // Then skip whole days, and finish with the hours of the current day
+    while (now - store.hour >= HOURS_PER_DAY)
+    {
+        roll_one_day();
+    }
+
+    while (store.hour != now)
+    {
+        roll_one_hour();
+    }
+}
+
+void watering_stats_record(uint32_t volume_ml, uint32_t pump_ms)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    advance();
+
+    struct stats_bucket *bucket = hour_bucket(store.hour);
+    bucket->volume_ml += volume_ml;
+    bucket->pump_ms += pump_ms;
+    bucket->count++;
+
+    k_spin_unlock(&lock, key);
+
+    LOG_INF("Recorded watering: %u ml, pump on %u ms", volume_ml, pump_ms);
+    k_work_schedule(&save_work, STATS_SAVE_DELAY);
+}
+
+static size_t put_bucket(uint8_t *buf, const struct stats_bucket *bucket)
+{
+    sys_put_le32(bucket->volume_ml, &buf[0]);
+    sys_put_le32(bucket->pump_ms, &buf[4]);
+    sys_put_le16(bucket->count, &buf[8]);
+    return WATERING_STATS_BUCKET_SIZE;
+}
+
+size_t watering_stats_serialize(uint8_t *buf)
+{
+    size_t len = 0;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    advance();
+
+    buf[len++] = STATS_VERSION;
+    buf[len++] = WATERING_STATS_HOURS;
+    buf[len++] = WATERING_STATS_DAYS;
+    buf[len++] = WATERING_STATS_WEEKS;
+
+    for (uint32_t i = 0; i < WATERING_STATS_HOURS; i++)
+    {
+        len += put_bucket(&buf[len], hours_ago(hour_bucket, i));
+    }
+
+    // The open day and week do not yet include the open hour and day
+    struct stats_bucket today = *day_bucket(store.hour);
+    bucket_add(&today, hour_bucket(store.hour));
+    len += put_bucket(&buf[len], &today);
+    for (uint32_t i = 1; i < WATERING_STATS_DAYS; i++)
+    {
+        len += put_bucket(&buf[len], hours_ago(day_bucket, i * HOURS_PER_DAY));
+    }
+
+    struct stats_bucket this_week = *week_bucket(store.hour);
+    bucket_add(&this_week, &today);
+    len += put_bucket(&buf[len], &this_week);
+    for (uint32_t i = 1; i < WATERING_STATS_WEEKS; i++)
+    {
+        len += put_bucket(&buf[len], hours_ago(week_bucket, i * HOURS_PER_WEEK));
+    }
+
+    k_spin_unlock(&lock, key);
+    return len;
+}
+
+/* --- PERSISTENCE --- */
+
+static void save_work_handler(struct k_work *work)
+{
+    static uint8_t deferrals;
+    struct stats_store copy;
+
+    // Flash writes are not critical, postpone them on a low battery, but not
+    // for so long that the rollups are lost when the battery finally gives out
+    if (energy_defer_background() && deferrals < STATS_SAVE_MAX_DEFERRALS)
+    {
+        deferrals++;
+        k_work_schedule(&save_work, K_HOURS(1));
+        return;
+    }
+    deferrals = 0;
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    advance();
+    copy = store;
+
+    k_spin_unlock(&lock, key);
+
+    int err = settings_save_one("stats/rollups", &copy, sizeof(copy));
+    if (err)
+    {
+        LOG_ERR("Failed to save watering stats (err %d)", err);
+    }
+}
+
+// Restore rollups; time without power is not known, so the hour count resumes
+static int stats_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    if (strcmp(name, "rollups") != 0 || len != sizeof(store))
+    {
+        return -ENOENT;
+    }
+
+    struct stats_store loaded;
+    ssize_t rc = read_cb(cb_arg, &loaded, sizeof(loaded));
+    if (rc < 0)
+    {
+        LOG_ERR("Failed to load watering stats (err %d)", (int)rc);
+        return (int)rc;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    store = loaded;
+    hour_offset = store.hour - (uint32_t)(k_uptime_get() / (MSEC_PER_SEC * 3600));
+
+    k_spin_unlock(&lock, key);
+
+    LOG_INF("Watering stats restored");
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(watering_stats, "stats", NULL, stats_settings_set, NULL, NULL);
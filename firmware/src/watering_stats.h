@@ -0,0 +1,41 @@
+#ifndef WATERING_STATS_H
+#define WATERING_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WATERING_STATS_HOURS 24 ///< Hourly buckets kept
+#define WATERING_STATS_DAYS 7   ///< Daily buckets kept
+#define WATERING_STATS_WEEKS 4  ///< Weekly buckets kept
+
+/* Serialized size: 4 byte header + 10 bytes per bucket */
+#define WATERING_STATS_BUCKET_SIZE 10
+#define WATERING_STATS_SERIALIZED_SIZE \
+    (4 + WATERING_STATS_BUCKET_SIZE * (WATERING_STATS_HOURS + WATERING_STATS_DAYS + WATERING_STATS_WEEKS))
+
+/**
+ * @brief Record one completed watering
+ *
+ * Adds to the current hourly bucket in O(1). Finished hours are folded into
+ * their day and finished days into their week as time moves on. Safe to call
+ * from interrupt context.
+ *
+ * @param volume_ml Volume delivered in milliliters
+ * @param pump_ms   Time the pump was on in milliseconds
+ */
+void watering_stats_record(uint32_t volume_ml, uint32_t pump_ms);
+
+/**
+ * @brief Serialize all rollups for the Stats characteristic
+ *
+ * Layout (little endian): version, hour/day/week bucket counts (4 x uint8),
+ * then hourly, daily and weekly buckets, each newest first. The first bucket
+ * of each group is the current, still open period. Each bucket is volume in
+ * mL (uint32), pump-on time in ms (uint32) and watering count (uint16).
+ *
+ * @param buf Output buffer of at least WATERING_STATS_SERIALIZED_SIZE bytes
+ * @return Number of bytes written
+ */
+size_t watering_stats_serialize(uint8_t *buf);
+
+#endif /* WATERING_STATS_H */